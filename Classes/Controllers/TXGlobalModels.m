@@ -44,6 +44,22 @@
 #pragma mark -
 #pragma mark Time.
 
+/* Lines tend to arrive in bursts within the same second so the last result
+ for each format is kept. The cache is keyed by format and each value is an 
+ array of the second it was formatted for and the formatted string. */
+#define _formattedTimestampCacheMaximumFormatCount		16
+
+static NSMutableDictionary *_formattedTimestampCache = nil;
+
+void TXFormattedTimestampInvalidateCache(void)
+{
+	PointerIsEmptyAssert(_formattedTimestampCache);
+
+	@synchronized(_formattedTimestampCache) {
+		[_formattedTimestampCache removeAllObjects];
+	}
+}
+
 NSString *TXFormattedTimestamp(NSDate *date, NSString *format)
 {
 	/* If the format is empty, a default is called. */
@@ -53,20 +69,56 @@ NSString *TXFormattedTimestamp(NSDate *date, NSString *format)
 	
 	/* Convert time to C object. */
 	time_t global = (time_t)[date timeIntervalSince1970];
+
+	/* Check cache. */
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		_formattedTimestampCache = [NSMutableDictionary new];
+
+		[RZNotificationCenter() addObserverForName:NSSystemTimeZoneDidChangeNotification
+											object:nil
+											 queue:nil
+										usingBlock:^(NSNotification *note) {
+											TXFormattedTimestampInvalidateCache();
+										}];
+	});
+
+	@synchronized(_formattedTimestampCache) {
+		NSArray *cachedValue = _formattedTimestampCache[format];
+
+		if (cachedValue && [cachedValue[0] longValue] == global) {
+			return cachedValue[1];
+		}
+	}
 	
 	/* Format time. */
 	const NSInteger _timeBufferSize = 256;
 	
-	struct tm *local = localtime(&global);
+	struct tm local;
+
+	localtime_r(&global, &local);
 	
 	char buf[(_timeBufferSize + 1)];
 	
-	strftime(buf, _timeBufferSize, [format UTF8String], local);
+	strftime(buf, _timeBufferSize, [format UTF8String], &local);
 	
 	buf[_timeBufferSize] = 0;
 	
 	/* Return results as UTF-8 string. */
-	return [NSString stringWithBytes:buf length:strlen(buf) encoding:NSUTF8StringEncoding];
+	NSString *formattedValue = [NSString stringWithBytes:buf length:strlen(buf) encoding:NSUTF8StringEncoding];
+
+	if (formattedValue) {
+		@synchronized(_formattedTimestampCache) {
+			if ([_formattedTimestampCache count] >= _formattedTimestampCacheMaximumFormatCount) {
+				[_formattedTimestampCache removeAllObjects];
+			}
+
+			_formattedTimestampCache[[format copy]] = @[@(global), formattedValue];
+		}
+	}
+
+	return formattedValue;
 }
 
 NSString *TXHumanReadableTimeInterval(NSInteger dateInterval, BOOL shortValue, NSCalendarUnit orderMatrix)
@@ -63,7 +63,9 @@ typedef NS_OPTIONS(NSUInteger, ClientIRCv3SupportedCapacities) {
 	ClientIRCv3SupportedCapacityIsIdentifiedWithSASL	= 1 << 8, // YES if SASL authentication was successful, else NO.
 	ClientIRCv3SupportedCapacityZNCSelfMessage			= 1 << 14, // YES if the ZNC vendor specific CAP supported.
 	ClientIRCv3SupportedCapacityZNCPlaybackModule		= 1 << 15,  // YES if the ZNC vendor specific CAP supported.
-	ClientIRCv3SupportedCapacityBatch					= 1 << 16  // YES if batch CAP supported.
+	ClientIRCv3SupportedCapacityBatch					= 1 << 16, // YES if batch CAP supported.
+	ClientIRCv3SupportedCapacityWHOXCommand				= 1 << 17, // YES if the WHOX extension of the WHO command is supported.
+	ClientIRCv3SupportedCapacityMonitorCommand			= 1 << 18  // YES if the MONITOR command is supported.
 };
 
 typedef void (^IRCClientPrintToWebViewCallbackBlock)(BOOL isHighlight);
@@ -178,6 +180,8 @@ TEXTUAL_EXTERN NSString * const IRCClientChannelListWasModifiedNotification;
 
 - (void)updateStoredChannelList;
 
+- (void)rebuildChannelLookupTables; // Invoked automatically when the channel list changes or a channel is renamed.
+
 - (void)selectFirstChannelInChannelList;
 
 - (void)cacheHighlightInChannel:(IRCChannel *)channel withLogLine:(TVCLogLine *)logLine;
@@ -188,6 +192,11 @@ TEXTUAL_EXTERN NSString * const IRCClientChannelListWasModifiedNotification;
 
 - (void)reachabilityChanged:(BOOL)reachable;
 
+// Returns a shared copy of a nickname, username, or address for use by IRCUser.
+- (NSString *)internedUserString:(NSString *)value;
+
+@property (readonly, copy) NSString *memberMemoryUsageDiagnostic;
+
 - (void)autoConnect:(NSInteger)delay afterWakeUp:(BOOL)afterWakeUp;
 
 @property (getter=isReconnecting, readonly) BOOL reconnecting;
@@ -258,6 +267,8 @@ TEXTUAL_EXTERN NSString * const IRCClientChannelListWasModifiedNotification;
 - (IRCChannel *)findChannelOrCreate:(NSString *)name;
 - (IRCChannel *)findChannelOrCreate:(NSString *)name isPrivateMessage:(BOOL)isPM;
 
+- (IRCChannel *)findChannelByIdentifier:(NSString *)identifier; // Matches either -treeUUID or -uniqueIdentifier
+
 - (NSData *)convertToCommonEncoding:(NSString *)data;
 - (NSString *)convertFromCommonEncoding:(NSData *)data;
 
@@ -38,10 +38,25 @@
 
 #import "TextualApplication.h"
 
+/* Number of entries in each of the lookup tables below. They are indexed by ASCII value. */
+#define IRCISupportLookupTableSize			128
+
+/* Values returned by -parameterTypeForChannelMode: */
+/* A through D are the four groups of the CHANMODES token, in order. */
+typedef NS_ENUM(NSUInteger, IRCISupportChannelModeParameterType) {
+	IRCISupportChannelModeParameterUnknownType			= 0,
+	IRCISupportChannelModeParameterListType				= 1, // A = Always has a paramater.
+	IRCISupportChannelModeParameterAlwaysType			= 2, // B = Always has a paramater.
+	IRCISupportChannelModeParameterWhenSetType			= 3, // C = Only has a paramater when set.
+	IRCISupportChannelModeParameterNeverType			= 4, // D = Never has a paramater.
+	IRCISupportChannelModeParameterUserPrefixType		= 100, // Mode from PREFIX; always has a paramater.
+};
+
 @interface IRCISupportInfo : NSObject
 @property (nonatomic, copy) NSDictionary *channelModes;
 @property (nonatomic, assign) NSInteger nicknameLength;
 @property (nonatomic, assign) NSInteger modesCount;
+@property (nonatomic, assign) NSInteger monitorTargetLimit; // 0 = no limit advertised
 @property (nonatomic, copy) NSString *channelNamePrefixes;
 @property (nonatomic, copy) NSString *networkAddress;
 @property (nonatomic, copy) NSString *networkName;
@@ -63,6 +78,23 @@
 - (BOOL)symbolIsUserPrefixCharacter:(NSString *)symbol;
 - (NSInteger)rankForUserPrefixWithMode:(NSString *)mode; // Starts at 100; 100 = highest rank
 
+/* The following are constant time lookups against tables that are compiled 
+ each time the PREFIX, CHANMODES, or CHANTYPES values change. Characters outside
+ of the ASCII range are never considered a prefix, mode, or channel type. */
+- (UniChar)modeForUserPrefixSymbol:(UniChar)symbol; // 0 if symbol is not a prefix
+- (UniChar)userPrefixSymbolForMode:(UniChar)mode; // 0 if mode is not a prefix mode
+- (NSInteger)rankForUserPrefixMode:(UniChar)mode; // Same values as -rankForUserPrefixWithMode:
+- (IRCISupportChannelModeParameterType)parameterTypeForChannelMode:(UniChar)mode;
+- (BOOL)characterIsChannelNamePrefix:(UniChar)character;
+
+/* Copies the CHANTYPES table into table which must hold IRCISupportLookupTableSize
+ entries. Callers testing many characters in a row can then index the copy directly. */
+- (void)getChannelNamePrefixTable:(BOOL *)table;
+
+/* Returns the modes matching the run of user prefix symbols at the start of string.
+ The length of that run is written to prefixLength when it is not NULL. */
+- (NSString *)userModesFromPrefixSymbolsInString:(NSString *)string prefixLength:(NSUInteger *)prefixLength;
+
 - (NSArray *)parseMode:(NSString *)modeString;
 - (IRCModeInfo *)createMode:(NSString *)mode;
 @end
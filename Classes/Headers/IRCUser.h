@@ -102,6 +102,8 @@ typedef NS_OPTIONS(NSUInteger, IRCUserRank) {
 
 - (void)migrate:(IRCUser *)from;
 
+@property (readonly) NSUInteger estimatedMemoryFootprint; // Size of the instance itself in bytes
+
 - (NSComparisonResult)compare:(IRCUser *)other;
 
 + (NSComparator)nicknameLengthComparator;
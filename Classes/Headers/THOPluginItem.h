@@ -54,6 +54,26 @@ typedef NS_OPTIONS(NSUInteger, THOPluginItemSupportedFeatures) {
 	THOPluginItemSupportsDidReceivePlainTextMessageEvent	= 1 << 9
 };
 
+/* Callbacks whose latency is recorded. Those marked as synchronous
+ are called on the hot path and are subject to the watchdog. */
+typedef NS_ENUM(NSUInteger, THOPluginItemCallback) {
+	THOPluginItemCallbackDidReceiveServerInput = 0,
+	THOPluginItemCallbackUserInputCommandInvoked,
+	THOPluginItemCallbackDidPostNewMessage,
+	THOPluginItemCallbackDidPostNewMessages,
+	THOPluginItemCallbackInterceptServerInput,			// Synchronous
+	THOPluginItemCallbackInterceptUserInput,			// Synchronous
+	THOPluginItemCallbackWillRenderMessage,				// Synchronous
+	THOPluginItemCallbackReceivedPlainTextMessage,		// Synchronous
+	THOPluginItemCallbackProcessInlineMediaContentURL,	// Synchronous
+	THOPluginItemCallbackCount
+};
+
+/* Each bucket of a latency histogram covers twice the time of the one
+ before it. The first covers less than two microseconds, the last anything
+ longer than about half a second. */
+#define THOPluginItemLatencyHistogramBucketCount		20
+
 @interface THOPluginItem : NSObject
 @property (readonly, strong) id primaryClass;
 @property (readonly, assign) THOPluginItemSupportedFeatures supportedFeatures;
@@ -62,10 +82,36 @@ typedef NS_OPTIONS(NSUInteger, THOPluginItemSupportedFeatures) {
 @property (readonly, copy) NSArray *outputSuppressionRules;
 @property (readonly, strong) NSView *pluginPreferencesPaneView;
 @property (readonly, copy) NSString *pluginPreferencesPaneMenuItemName;
+@property (readonly, copy) NSString *pluginName;
+
+/* Events delivered asynchronously to the plugin are performed on this queue.
+ It is created by THOPluginManager when the plugin is loaded. */
+@property (nonatomic, strong) dispatch_queue_t dispatchQueue;
+
+/* The number of events that were discarded because the
+ plugin had too many waiting to be performed. */
+@property (readonly, assign) NSUInteger droppedEventCount;
+
+/* A plugin disabled by the watchdog no longer reports any supported feature. */
+@property (readonly, assign) BOOL disabledByWatchdog;
 
 - (BOOL)loadBundle:(NSBundle *)bundle;
 
 - (BOOL)supportsFeature:(THOPluginItemSupportedFeatures)feature;
 
+/* Performs the block on the plugin's dispatch queue unless its backlog is full,
+ in which case the block is discarded and the drop is counted. */
+- (void)performBlockOnDispatchQueue:(dispatch_block_t)block;
+
+/* Blocks that must not be lost, such as a command typed by the user,
+ pass NO for allowDropping to be queued even when the backlog is full. */
+- (void)performBlockOnDispatchQueue:(dispatch_block_t)block allowDropping:(BOOL)allowDropping;
+
+/* startTime is a value returned by mach_absolute_time() before the callback was invoked. */
+- (void)recordLatencySinceTime:(uint64_t)startTime forCallback:(THOPluginItemCallback)callback;
+
+/* One line for each callback that has been invoked at least once. */
+- (NSArray *)latencyReport;
+
 - (void)sendDealloc;
 @end
@@ -37,6 +37,13 @@
 
 #import "TextualApplication.h"
 
+typedef NS_ENUM(NSUInteger, THOPluginOutputSuppressionRuleScope) {
+	THOPluginOutputSuppressionRuleScopeConsole = 0,
+	THOPluginOutputSuppressionRuleScopeChannel,
+	THOPluginOutputSuppressionRuleScopePrivateMessage,
+	THOPluginOutputSuppressionRuleScopeCount
+};
+
 /* Please DO NOT use any code declared within this header inside of a plugin.
  The code contained by this header file was designed to be used internally for
  Textual and may be dangerous to use otherwise. */
@@ -44,6 +51,12 @@
 @interface THOPluginManager : NSObject
 @property (nonatomic, strong) dispatch_queue_t dispatchQueue;
 
+/* Watchdog configuration, refreshed by -preferencesChanged. The budget is in nanoseconds. */
+@property (readonly, assign) uint64_t watchdogLatencyBudget;
+@property (readonly, assign) BOOL watchdogDisablesSlowPlugins;
+
+- (void)preferencesChanged;
+
 /* Manage loaded plugins. */
 - (void)loadPlugins;
 - (void)unloadPlugins;
@@ -61,6 +74,15 @@
 
 @property (readonly, copy) NSArray *pluginOutputSuppressionRules;
 
+/* Output suppression rules are gathered and compiled once when plugins load.
+ -hasOutputSuppressionRulesForScope: is cheap enough to call for every message. */
+- (BOOL)hasOutputSuppressionRulesForScope:(THOPluginOutputSuppressionRuleScope)scope;
+
+- (BOOL)outputSuppressionRulesMatchMessage:(NSString *)message inScope:(THOPluginOutputSuppressionRuleScope)scope;
+
+/* Latency of each plugin callback, one line per plugin and callback. */
+@property (readonly, copy) NSArray *pluginLatencyReport;
+
 /* Returns YES if at least one loaded plugin supports the feature. */
 - (BOOL)supportsFeature:(THOPluginItemSupportedFeatures)feature;
 
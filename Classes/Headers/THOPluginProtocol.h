@@ -215,6 +215,28 @@ TEXTUAL_EXTERN NSString * const THOPluginProtocolCompatibilityMinimumVersion;
  */
 - (void)didPostNewMessage:(THOPluginDidPostNewMessageConcreteObject *)messageObject forViewController:(TVCLogController *)logController;
 
+/*!
+ * @brief Method invoked with the messages added to the Document Object Model (DOM) 
+ *  of a view since the last time it was invoked.
+ *
+ * @discussion Messages are collected for up to one display frame (about 1/60th of a 
+ *  second) and delivered together, in the order they were posted. This results in far 
+ *  fewer invocations than -didPostNewMessage:forViewController: when many messages are 
+ *  posted at once, such as during playback of history.
+ *
+ *  A plugin that implements this method will not have -didPostNewMessage:forViewController: 
+ *  invoked for the same messages.
+ *
+ * @warning This method is invoked on an asynchronous background dispatch queue. Not the
+ *  main thread.
+ *
+ * @param messageObjects An array of THOPluginDidPostNewMessageConcreteObject instances
+ * @param logController The view responsible for the event
+ *
+ * @see THOPluginDidPostNewMessageConcreteObject
+ */
+- (void)didPostNewMessages:(NSArray *)messageObjects forViewController:(TVCLogController *)logController;
+
 #pragma mark -
 
 /*!
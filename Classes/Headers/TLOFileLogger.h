@@ -50,6 +50,9 @@ TEXTUAL_EXTERN NSString * const TLOFileLoggerNoticeNicknameFormat;
 TEXTUAL_EXTERN NSString * const TLOFileLoggerISOStandardClockFormat;
 TEXTUAL_EXTERN NSString * const TLOFileLoggerTwentyFourHourClockFormat;
 
+TEXTUAL_EXTERN NSString * const TLOFileLoggerCompressedTranscriptPathExtension;
+TEXTUAL_EXTERN NSString * const TLOFileLoggerStructuredTranscriptPathExtension;
+
 @interface TLOFileLogger : NSObject
 @property (nonatomic, weak) IRCClient *client;
 @property (nonatomic, weak) IRCChannel *channel;
@@ -63,4 +66,14 @@ TEXTUAL_EXTERN NSString * const TLOFileLoggerTwentyFourHourClockFormat;
 
 - (void)writeLine:(TVCLogLine *)logLine;
 - (void)writePlainTextLine:(NSString *)s;
+
+/* When structured transcripts are enabled, each line is also written to a file
+ with the extension "jsonl" as the JSON representation of its TVCLogLine, one
+ entry per line. These files are not compressed by the archiver. The readers
+ below map the file into memory, or read it in chunks while a logger has it
+ open, and hand out one entry at a time. The data handed to the first is only
+ valid for the duration of the block. Both return NO if the file could not be
+ read. */
++ (BOOL)enumerateEntriesInStructuredTranscriptAtURL:(NSURL *)url usingBlock:(void (^)(NSData *entryData, BOOL *stop))block;
++ (BOOL)enumerateLogLinesInStructuredTranscriptAtURL:(NSURL *)url usingBlock:(void (^)(TVCLogLine *logLine, BOOL *stop))block;
 @end
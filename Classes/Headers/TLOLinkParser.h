@@ -41,5 +41,11 @@
 @interface TLOLinkParser : NSObject
 + (NSArray *)locatedLinksForString:(NSString *)body;
 
+/* Cheap check used to skip the scanner for lines that cannot contain a link. */
++ (BOOL)stringMayContainLinks:(NSString *)body;
+
+/* Returns an identifier that is unique for the lifetime of the process. */
++ (NSString *)uniqueLinkIdentifier;
+
 + (NSArray *)bannedLineTypes;
 @end
@@ -120,9 +120,18 @@ typedef NS_ENUM(NSUInteger, TXFileTransferIPAddressDetectionMethod) {
 + (BOOL)logToDisk; // Checks whether checkbox for logging is checked.
 + (BOOL)logToDiskIsEnabled; // Checks whether checkbox is checked and whether an actual path is configured.
 
++ (BOOL)logTranscriptCompressionEnabled;
++ (NSUInteger)logTranscriptCompressionDelay; // Age in days at which a transcript is compressed.
++ (BOOL)logTranscriptInStructuredFormat;
+
++ (NSUInteger)pluginWatchdogLatencyBudget; // Milliseconds. Zero disables the watchdog.
++ (BOOL)pluginWatchdogDisablesSlowPlugins;
+
 + (BOOL)postNotificationsWhileInFocus;
 
 + (BOOL)automaticallyFilterUnicodeTextSpam;
++ (BOOL)deferRenderingInHiddenViews;
++ (NSUInteger)automaticallyFilterUnicodeTextSpamMaximumCombiningCharacters;
 
 + (BOOL)conversationTrackingIncludesUserModeSymbol;
 
@@ -62,4 +62,10 @@
 
 - (GRMustacheTemplate *)templateWithLineType:(TVCLogLineType)type;
 - (GRMustacheTemplate *)templateWithName:(NSString *)name;
+
+/* Renders a template that was compiled for the active theme without going through
+ GRMustache. Newlines are removed from the result. Returns nil when the template uses
+ features that are only available through GRMustache, in which case the caller 
+ should render the result of -templateWithName: instead. */
+- (NSString *)renderCompiledTemplateWithName:(NSString *)name attributes:(NSDictionary *)attributes;
 @end
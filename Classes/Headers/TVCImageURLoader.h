@@ -39,8 +39,8 @@
 
 @protocol TVCImageURLoaderDelegate;
 
-@interface TVCImageURLoader : NSObject <NSURLConnectionDelegate, NSURLConnectionDataDelegate>
-@property (nonatomic, unsafe_unretained) id <TVCImageURLoaderDelegate> delegate;
+@interface TVCImageURLoader : NSObject
+@property (nonatomic, weak) id <TVCImageURLoaderDelegate> delegate;
 
 + (void)invalidateInternalCache;
 
@@ -59,6 +59,11 @@ TEXTUAL_EXTERN NSString * const TVCLogControllerViewFinishedLoadingNotification;
 @property (assign) BOOL reloadingBacklog;
 @property (assign) BOOL reloadingHistory;
 
+/* Brackets the creation of views at launch so that the history of all
+ views is not reported as restored before every view has begun restoring. */
++ (void)beginRestoringHistoryOfViews;
++ (void)endRestoringHistoryOfViews;
+
 - (void)setUp;
 - (void)notifyDidBecomeVisible;
 
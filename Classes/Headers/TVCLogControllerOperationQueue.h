@@ -56,6 +56,9 @@ typedef void (^TVCLogControllerOperationBlock)(NSOperation *sender);
 
 - (void)cancelOperationsForViewController:(TVCLogController *)controller;
 
+/* Move standalone operations of a view that has been selected ahead of those of other views. */
+- (void)prioritizeOperationsForViewController:(TVCLogController *)controller;
+
 /* Update state. */
 - (void)updateReadinessState:(TVCLogController *)controller;
 @end
@@ -46,6 +46,7 @@ TEXTUAL_EXTERN NSString *TXLocalizedStringAlternative(NSBundle *bundle, NSString
 
 /* Time. */
 TEXTUAL_EXTERN NSString *TXFormattedTimestamp(NSDate *date, NSString *format); // Acts as a forward for strftime(). TXDefaultTextualTimestampFormat is used when format is empty.
+TEXTUAL_EXTERN void TXFormattedTimestampInvalidateCache(void); // The last result for each format is cached until the second changes.
 
 TEXTUAL_EXTERN NSString *TXHumanReadableTimeInterval(NSInteger dateInterval, BOOL shortValue, NSCalendarUnit orderMatrix);
 
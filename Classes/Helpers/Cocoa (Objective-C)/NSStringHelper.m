@@ -196,20 +196,19 @@ NSStringEncoding const TXDefaultFallbackStringEncoding		= NSISOLatin1StringEncod
 		return [self isChannelName];
 	}
 
-	NSString *validChars = [[client supportInfo] channelNamePrefixes];
+	IRCISupportInfo *supportInfo = [client supportInfo];
 
-	if ([self length] == 1) {
-		NSString *c = [self stringCharacterAtIndex:0];
+	UniChar c1 = [self characterAtIndex:0];
 
-		return [c onlyContainsCharacters:validChars];
+	if ([self length] == 1) {
+		return [supportInfo characterIsChannelNamePrefix:c1];
 	} else {
-		NSString *c1 = [self stringCharacterAtIndex:0];
-		NSString *c2 = [self stringCharacterAtIndex:1];
+		UniChar c2 = [self characterAtIndex:1];
 		
 		/* The ~ prefix is considered special. It is used by the ZNC partyline plugin. */
-		BOOL isPartyline = ([c1 isEqualToString:@"~"] && [c2 isEqualToString:@"#"]);
+		BOOL isPartyline = (c1 == '~' && c2 == '#');
 
-		return ([c1 onlyContainsCharacters:validChars] || isPartyline);
+		return ([supportInfo characterIsChannelNamePrefix:c1] || isPartyline);
 	}
 }
 
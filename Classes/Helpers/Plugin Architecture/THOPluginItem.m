@@ -39,7 +39,36 @@
 
 #import "BuildConfig.h"
 
+#import <mach/mach_time.h>
+
+#import <stdatomic.h>
+
+/* The number of events that can be waiting on the dispatch queue
+ of a plugin before new events are dropped. */
+#define _pluginEventBacklogMaximum				500
+
+/* The number of times a plugin has to exceed the latency budget
+ before the watchdog disables it, when allowed to do so. */
+#define _watchdogMaximumBudgetOverruns			5
+
+/* Minimum number of seconds between two warnings for the same plugin. */
+#define _watchdogWarningInterval				10
+
 @interface THOPluginItem ()
+{
+	uint64_t _latencyHistogram[THOPluginItemCallbackCount][THOPluginItemLatencyHistogramBucketCount];
+	uint64_t _latencyTotal[THOPluginItemCallbackCount];
+	uint64_t _latencyMaximum[THOPluginItemCallbackCount];
+	uint64_t _latencyCount[THOPluginItemCallbackCount];
+
+	NSUInteger _budgetOverrunCount;
+
+	NSTimeInterval _lastWatchdogWarning;
+
+	_Atomic(int32_t) _pendingEventCount;
+	_Atomic(int64_t) _droppedEventCount;
+}
+
 @property (nonatomic, readwrite, strong) id primaryClass;
 @property (nonatomic, readwrite, assign) THOPluginItemSupportedFeatures supportedFeatures;
 @property (nonatomic, readwrite, copy) NSArray *supportedUserInputCommands;
@@ -47,8 +76,42 @@
 @property (nonatomic, readwrite, copy) NSArray *outputSuppressionRules;
 @property (nonatomic, readwrite, strong) NSView *pluginPreferencesPaneView;
 @property (nonatomic, readwrite, copy) NSString *pluginPreferencesPaneMenuItemName;
+@property (nonatomic, readwrite, copy) NSString *pluginName;
+@property (nonatomic, readwrite, assign) BOOL disabledByWatchdog;
 @end
 
+static NSString *THOPluginItemCallbackName(THOPluginItemCallback callback)
+{
+	switch (callback) {
+		case THOPluginItemCallbackDidReceiveServerInput:			{ return @"didReceiveServerInput"; }
+		case THOPluginItemCallbackUserInputCommandInvoked:			{ return @"userInputCommandInvoked"; }
+		case THOPluginItemCallbackDidPostNewMessage:				{ return @"didPostNewMessage"; }
+		case THOPluginItemCallbackDidPostNewMessages:				{ return @"didPostNewMessages"; }
+		case THOPluginItemCallbackInterceptServerInput:				{ return @"interceptServerInput"; }
+		case THOPluginItemCallbackInterceptUserInput:				{ return @"interceptUserInput"; }
+		case THOPluginItemCallbackWillRenderMessage:				{ return @"willRenderMessage"; }
+		case THOPluginItemCallbackReceivedPlainTextMessage:			{ return @"receivedText"; }
+		case THOPluginItemCallbackProcessInlineMediaContentURL:		{ return @"processInlineMediaContentURL"; }
+		default:													{ return nil; }
+	}
+}
+
+static BOOL THOPluginItemCallbackIsSynchronous(THOPluginItemCallback callback)
+{
+	return (callback >= THOPluginItemCallbackInterceptServerInput && callback < THOPluginItemCallbackCount);
+}
+
+static uint64_t THOPluginItemNanosecondsFromAbsoluteTime(uint64_t absoluteTime)
+{
+	static mach_timebase_info_data_t timebaseInfo;
+
+	if (timebaseInfo.denom == 0) {
+		mach_timebase_info(&timebaseInfo);
+	}
+
+	return ((absoluteTime * timebaseInfo.numer) / timebaseInfo.denom);
+}
+
 @implementation THOPluginItem
 
 #define VOCT(o, t)				 [o isKindOfClass:[t class]]
@@ -108,6 +171,8 @@
 
 	self.primaryClass = [principalClass new];
 
+	self.pluginName = [[[bundle bundlePath] lastPathComponent] stringByDeletingPathExtension];
+
 	if ([self.primaryClass respondsToSelector:@selector(pluginLoadedIntoMemory)]) {
 		[self.primaryClass pluginLoadedIntoMemory];
 	}
@@ -197,7 +262,8 @@
 	 to ask if it responds to the responder everytime we call it. */
 
 	/* Renderer events. */
-	if ([self.primaryClass respondsToSelector:@selector(didPostNewMessage:forViewController:)] ||
+	if ([self.primaryClass respondsToSelector:@selector(didPostNewMessages:forViewController:)] ||
+		[self.primaryClass respondsToSelector:@selector(didPostNewMessage:forViewController:)] ||
 		[self.primaryClass respondsToSelector:@selector(didPostNewMessageForViewController:messageInfo:isThemeReload:isHistoryReload:)])
 	{
 		supportedFeatures |= THOPluginItemSupportsNewMessagePostedEvent;
@@ -244,7 +310,176 @@
 
 - (BOOL)supportsFeature:(THOPluginItemSupportedFeatures)feature
 {
+	if (_disabledByWatchdog) {
+		return NO;
+	}
+
 	return ((_supportedFeatures & feature) == feature);
 }
 
+#pragma mark -
+#pragma mark Event Dispatch
+
+- (void)performBlockOnDispatchQueue:(dispatch_block_t)block
+{
+	[self performBlockOnDispatchQueue:block allowDropping:YES];
+}
+
+- (void)performBlockOnDispatchQueue:(dispatch_block_t)block allowDropping:(BOOL)allowDropping
+{
+	PointerIsEmptyAssert(block);
+
+	PointerIsEmptyAssert(self.dispatchQueue);
+
+	if ((atomic_fetch_add(&_pendingEventCount, 1) + 1) > _pluginEventBacklogMaximum && allowDropping) {
+		atomic_fetch_sub(&_pendingEventCount, 1);
+
+		int64_t droppedEventCount = (atomic_fetch_add(&_droppedEventCount, 1) + 1);
+
+		if (droppedEventCount == 1 || (droppedEventCount % 1000) == 0) {
+			LogToConsole(@"WARNING: Plugin “%@“ is not keeping up with events. %lld events have been dropped so far.", self.pluginName, droppedEventCount);
+		}
+
+		return;
+	}
+
+	dispatch_async(self.dispatchQueue, ^{
+		block();
+
+		atomic_fetch_sub(&_pendingEventCount, 1);
+	});
+}
+
+- (NSUInteger)droppedEventCount
+{
+	return (NSUInteger)atomic_load(&_droppedEventCount);
+}
+
+#pragma mark -
+#pragma mark Latency Accounting
+
+- (void)recordLatencySinceTime:(uint64_t)startTime forCallback:(THOPluginItemCallback)callback
+{
+	uint64_t elapsedTime = THOPluginItemNanosecondsFromAbsoluteTime(mach_absolute_time() - startTime);
+
+	uint64_t elapsedMicroseconds = (elapsedTime / 1000);
+
+	/* Bucket is the position of the highest bit set. */
+	NSUInteger bucket = 0;
+
+	if (elapsedMicroseconds > 1) {
+		bucket = (63 - __builtin_clzll(elapsedMicroseconds));
+	}
+
+	if (bucket >= THOPluginItemLatencyHistogramBucketCount) {
+		bucket = (THOPluginItemLatencyHistogramBucketCount - 1);
+	}
+
+	@synchronized(self) {
+		_latencyHistogram[callback][bucket] += 1;
+
+		_latencyTotal[callback] += elapsedTime;
+
+		_latencyCount[callback] += 1;
+
+		if (elapsedTime > _latencyMaximum[callback]) {
+			_latencyMaximum[callback] = elapsedTime;
+		}
+	}
+
+	if (THOPluginItemCallbackIsSynchronous(callback)) {
+		uint64_t latencyBudget = [sharedPluginManager() watchdogLatencyBudget];
+
+		if (latencyBudget > 0 && elapsedTime > latencyBudget) {
+			[self watchdogBudgetExceededByCallback:callback withLatency:elapsedTime];
+		}
+	}
+}
+
+- (void)watchdogBudgetExceededByCallback:(THOPluginItemCallback)callback withLatency:(uint64_t)elapsedTime
+{
+	BOOL logWarning = NO;
+	BOOL disablePlugin = NO;
+
+	NSUInteger overrunCount = 0;
+
+	@synchronized(self) {
+		if (_disabledByWatchdog) {
+			return;
+		}
+
+		_budgetOverrunCount += 1;
+
+		overrunCount = _budgetOverrunCount;
+
+		if (overrunCount >= _watchdogMaximumBudgetOverruns && [sharedPluginManager() watchdogDisablesSlowPlugins]) {
+			_disabledByWatchdog = YES;
+
+			disablePlugin = YES;
+		}
+
+		NSTimeInterval currentTime = [NSDate unixTime];
+
+		if (disablePlugin || (currentTime - _lastWatchdogWarning) >= _watchdogWarningInterval) {
+			_lastWatchdogWarning = currentTime;
+
+			logWarning = YES;
+		}
+	}
+
+	if (logWarning) {
+		LogToConsole(@"WARNING: Plugin “%@“ took %.3f ms to return from %@ which exceeds the budget of %.3f ms (%lu times so far)",
+					 self.pluginName, (elapsedTime / 1000000.0), THOPluginItemCallbackName(callback),
+					 ([sharedPluginManager() watchdogLatencyBudget] / 1000000.0), (unsigned long)overrunCount);
+	}
+
+	if (disablePlugin) {
+		LogToConsole(@"WARNING: Plugin “%@“ has been disabled for the remainder of this session because it is too slow to respond.", self.pluginName);
+	}
+}
+
+- (NSArray *)latencyReport
+{
+	NSMutableArray *reportLines = [NSMutableArray array];
+
+	@synchronized(self) {
+		for (NSUInteger callback = 0; callback < THOPluginItemCallbackCount; callback++) {
+			uint64_t callCount = _latencyCount[callback];
+
+			if (callCount == 0) {
+				continue;
+			}
+
+			/* Percentiles are reported as the upper bound of the bucket they fall in. */
+			uint64_t p50Bound = 0;
+			uint64_t p99Bound = 0;
+
+			uint64_t runningCount = 0;
+
+			for (NSUInteger bucket = 0; bucket < THOPluginItemLatencyHistogramBucketCount; bucket++) {
+				runningCount += _latencyHistogram[callback][bucket];
+
+				uint64_t bucketBound = (2ULL << bucket);
+
+				if (p50Bound == 0 && (runningCount * 2) >= callCount) {
+					p50Bound = bucketBound;
+				}
+
+				if (p99Bound == 0 && (runningCount * 100) >= (callCount * 99)) {
+					p99Bound = bucketBound;
+				}
+			}
+
+			uint64_t meanLatency = ((_latencyTotal[callback] / callCount) / 1000);
+
+			uint64_t maximumLatency = (_latencyMaximum[callback] / 1000);
+
+			[reportLines addObject:BLS(1289, self.pluginName, THOPluginItemCallbackName(callback),
+									   callCount, meanLatency, p50Bound, p99Bound, maximumLatency)];
+		}
+	}
+
+	return reportLines;
+}
+
 @end
@@ -40,10 +40,22 @@
 
 #import "THOPluginProtocolPrivate.h"
 
+#import <mach/mach_time.h>
+
+/* Posted messages are collected for one display frame before
+ being delivered to plugins that accept them in batches. */
+#define _newMessageBatchInterval			(NSEC_PER_SEC / 60)
+
 @interface THOPluginManager ()
+@property (nonatomic, readwrite, assign) uint64_t watchdogLatencyBudget;
+@property (nonatomic, readwrite, assign) BOOL watchdogDisablesSlowPlugins;
 @property (nonatomic, copy) NSArray *allLoadedBundles;
 @property (nonatomic, copy) NSArray *allLoadedPlugins;
 @property (nonatomic, assign) THOPluginItemSupportedFeatures supportedFeatures;
+@property (copy) NSArray *cachedOutputSuppressionRules;
+@property (copy) NSArray *compiledOutputSuppressionRules;
+@property (nonatomic, strong) NSMapTable *pendingNewMessageBatches;
+@property (nonatomic, assign) BOOL newMessageBatchFlushScheduled;
 @end
 
 NSString * const THOPluginProtocolCompatibilityMinimumVersion = @"5.0.0";
@@ -82,8 +94,12 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 	if ((self = [super init])) {
 		self.dispatchQueue = dispatch_queue_create("PluginManagerDispatchQueue", DISPATCH_QUEUE_SERIAL);
 
+		self.pendingNewMessageBatches = [NSMapTable strongToStrongObjectsMapTable];
+
 		_supportedFeatures = 0;
 
+		[self preferencesChanged];
+
 		return self;
 	}
 
@@ -97,6 +113,14 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 	}
 }
 
+- (void)preferencesChanged
+{
+	/* Cached because it is consulted after every synchronous callback. */
+	self.watchdogLatencyBudget = ([TPCPreferences pluginWatchdogLatencyBudget] * NSEC_PER_MSEC);
+
+	self.watchdogDisablesSlowPlugins = [TPCPreferences pluginWatchdogDisablesSlowPlugins];
+}
+
 #pragma mark -
 #pragma mark Retain & Release
 
@@ -107,6 +131,9 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 			NSAssert(NO, @"-loadPlugins called more than one time.");
 		}
 
+		/* Preferences may not have been registered when we were created. */
+		[self preferencesChanged];
+
 		NSArray *paths = [TPCPathInfo buildPathArray:
 						  [TPCPathInfo customExtensionFolderPath],
 						  [TPCPathInfo bundledExtensionFolderPath],
@@ -143,6 +170,12 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 				BOOL bundleLoaded = [currPlugin loadBundle:currBundle];
 
 				if (bundleLoaded) {
+					/* Each plugin performs events on its own queue so that
+					 a slow plugin does not hold up events for the others. */
+					NSString *queueName = [NSString stringWithFormat:@"PluginDispatchQueue-%@", [currPlugin pluginName]];
+
+					[currPlugin setDispatchQueue:dispatch_queue_create([queueName UTF8String], DISPATCH_QUEUE_SERIAL)];
+
 					[self updateSupportedFeaturesPropertyWithPlugin:currPlugin];
 
 					[loadedBundles addObject:currBundle];
@@ -157,6 +190,8 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 		self.allLoadedBundles = loadedBundles;
 
 		self.allLoadedPlugins = loadedPlugins;
+
+		[self compileOutputSuppressionRules];
 	});
 }
 
@@ -170,6 +205,12 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 		self.allLoadedBundles = nil;
 
 		self.allLoadedPlugins = nil;
+
+		self.cachedOutputSuppressionRules = nil;
+
+		self.compiledOutputSuppressionRules = nil;
+
+		[self.pendingNewMessageBatches removeAllObjects];
 	});
 }
 
@@ -395,8 +436,29 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 
 - (NSArray *)pluginOutputSuppressionRules
 {
+	NSArray *allRules = self.cachedOutputSuppressionRules;
+
+	if (allRules == nil) {
+		return @[];
+	}
+
+	return allRules;
+}
+
+- (void)compileOutputSuppressionRules
+{
+	/* Rules do not change once a plugin is loaded so they are gathered
+	 here one time and sorted by the scope that they apply to. Each scope
+	 is then compiled to as few expressions as possible by joining the
+	 patterns together as alternatives of a single expression. */
 	NSMutableArray *allRules = [NSMutableArray array];
 
+	NSMutableArray *patternsByScope[THOPluginOutputSuppressionRuleScopeCount];
+
+	for (NSUInteger i = 0; i < THOPluginOutputSuppressionRuleScopeCount; i++) {
+		patternsByScope[i] = [NSMutableArray array];
+	}
+
 	for (THOPluginItem *plugin in self.allLoadedPlugins) {
 		if ([plugin supportsFeature:THOPluginItemSupportsOutputSuppressionRules]) {
 			NSArray *srules = [plugin outputSuppressionRules];
@@ -407,7 +469,137 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 		}
 	}
 
-	return allRules;
+	for (THOPluginOutputSuppressionRule *rule in allRules) {
+		NSString *pattern = [rule match];
+
+		NSObjectIsEmptyAssertLoopContinue(pattern);
+
+		/* A rule that does not compile could never have matched. */
+		if ([NSRegularExpression regularExpressionWithPattern:pattern options:0 error:NULL] == nil) {
+			LogToConsole(@"Ignoring output suppression rule with invalid pattern: %@", pattern);
+
+			continue;
+		}
+
+		if ([rule restrictConsole]) {
+			[patternsByScope[THOPluginOutputSuppressionRuleScopeConsole] addObject:pattern];
+		}
+
+		if ([rule restrictChannel]) {
+			[patternsByScope[THOPluginOutputSuppressionRuleScopeChannel] addObject:pattern];
+		}
+
+		if ([rule restrictPrivateMessage]) {
+			[patternsByScope[THOPluginOutputSuppressionRuleScopePrivateMessage] addObject:pattern];
+		}
+	}
+
+	NSMutableArray *compiledRules = [NSMutableArray arrayWithCapacity:THOPluginOutputSuppressionRuleScopeCount];
+
+	for (NSUInteger i = 0; i < THOPluginOutputSuppressionRuleScopeCount; i++) {
+		[compiledRules addObject:[self compiledExpressionsForOutputSuppressionPatterns:patternsByScope[i]]];
+	}
+
+	self.cachedOutputSuppressionRules = allRules;
+
+	self.compiledOutputSuppressionRules = compiledRules;
+}
+
+- (NSArray *)compiledExpressionsForOutputSuppressionPatterns:(NSArray *)patterns
+{
+	NSMutableArray *expressions = [NSMutableArray array];
+
+	NSMutableArray *joinablePatterns = [NSMutableArray array];
+
+	for (NSString *pattern in patterns) {
+		/* Back references and named groups are numbered relative to the
+		 whole expression so a pattern using them is compiled on its own. */
+		if ([XRRegularExpression string:pattern isMatchedByRegex:@"(\\\\[1-9]|\\\\k<|\\(\\?<[a-zA-Z])"]) {
+			NSRegularExpression *expression = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:NULL];
+
+			if (expression) {
+				[expressions addObject:expression];
+			}
+		} else {
+			[joinablePatterns addObject:[NSString stringWithFormat:@"(?:%@)", pattern]];
+		}
+	}
+
+	if ([joinablePatterns count] > 0) {
+		NSString *joinedPattern = [joinablePatterns componentsJoinedByString:@"|"];
+
+		NSRegularExpression *expression = [NSRegularExpression regularExpressionWithPattern:joinedPattern options:0 error:NULL];
+
+		if (expression) {
+			[expressions addObject:expression];
+		} else {
+			/* Patterns that are valid alone may still not join cleanly. */
+			for (NSString *pattern in joinablePatterns) {
+				expression = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:NULL];
+
+				if (expression) {
+					[expressions addObject:expression];
+				}
+			}
+		}
+	}
+
+	return expressions;
+}
+
+- (BOOL)hasOutputSuppressionRulesForScope:(THOPluginOutputSuppressionRuleScope)scope
+{
+	NSAssertReturnR((scope < THOPluginOutputSuppressionRuleScopeCount), NO);
+
+	NSArray *compiledRules = self.compiledOutputSuppressionRules;
+
+	if (compiledRules == nil) {
+		return NO;
+	}
+
+	return ([compiledRules[scope] count] > 0);
+}
+
+- (BOOL)outputSuppressionRulesMatchMessage:(NSString *)message inScope:(THOPluginOutputSuppressionRuleScope)scope
+{
+	NSObjectIsEmptyAssertReturn(message, NO);
+
+	NSAssertReturnR((scope < THOPluginOutputSuppressionRuleScopeCount), NO);
+
+	NSArray *compiledRules = self.compiledOutputSuppressionRules;
+
+	if (compiledRules == nil) {
+		return NO;
+	}
+
+	NSRange searchRange = NSMakeRange(0, [message length]);
+
+	for (NSRegularExpression *expression in compiledRules[scope]) {
+		if ([expression firstMatchInString:message options:0 range:searchRange]) {
+			return YES;
+		}
+	}
+
+	return NO;
+}
+
+- (NSArray *)pluginLatencyReport
+{
+	NSMutableArray *reportLines = [NSMutableArray array];
+
+	for (THOPluginItem *plugin in self.allLoadedPlugins) {
+		[reportLines addObjectsFromArray:[plugin latencyReport]];
+
+		if ([plugin disabledByWatchdog]) {
+			[reportLines addObject:BLS(1290, [plugin pluginName])];
+		}
+
+		if ([plugin droppedEventCount] > 0) {
+			[reportLines addObject:BLS(1292, [plugin pluginName], [plugin droppedEventCount])];
+		}
+	}
+
+	return reportLines;
 }
 
 - (NSArray *)supportedUserInputCommands
@@ -492,7 +684,13 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 		{
 			if ([plugin supportsFeature:THOPluginItemSupportsSubscribedUserInputCommands]) {
 				if ([[plugin supportedUserInputCommands] containsObject:lowercaseCommand]) {
-					[[plugin primaryClass] userInputCommandInvokedOnClient:client commandString:uppercaseCommand messageString:message];
+					[plugin performBlockOnDispatchQueue:^{
+						uint64_t startTime = mach_absolute_time();
+
+						[[plugin primaryClass] userInputCommandInvokedOnClient:client commandString:uppercaseCommand messageString:message];
+
+						[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackUserInputCommandInvoked];
+					} allowDropping:NO];
 				}
 			}
 		}
@@ -539,7 +737,13 @@ NSString * const THOPluginProtocolDidReceiveServerInputMessageNetworkNameAttribu
 				}
 
 				if ([[plugin primaryClass] respondsToSelector:@selector(didReceiveServerInput:onClient:)]) {
-					[[plugin primaryClass] didReceiveServerInput:messageObject onClient:client];
+					[plugin performBlockOnDispatchQueue:^{
+						uint64_t startTime = mach_absolute_time();
+
+						[[plugin primaryClass] didReceiveServerInput:messageObject onClient:client];
+
+						[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackDidReceiveServerInput];
+					}];
 				} else if ([[plugin primaryClass] respondsToSelector:@selector(didReceiveServerInputOnClient:senderInformation:messageInformation:)]) {
 
 TEXTUAL_IGNORE_DEPRECATION_BEGIN
@@ -565,7 +769,18 @@ TEXTUAL_IGNORE_DEPRECATION_BEGIN
 						 };
 					}
 
-					[[plugin primaryClass] didReceiveServerInputOnClient:client senderInformation:senderData messageInformation:messageData];
+					/* The dictionaries are shared by all plugins and are therefore
+					 created here instead of on the queue of the plugin. */
+					NSDictionary *senderDataCopy = senderData;
+					NSDictionary *messageDataCopy = messageData;
+
+					[plugin performBlockOnDispatchQueue:^{
+						uint64_t startTime = mach_absolute_time();
+
+						[[plugin primaryClass] didReceiveServerInputOnClient:client senderInformation:senderDataCopy messageInformation:messageDataCopy];
+
+						[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackDidReceiveServerInput];
+					}];
 TEXTUAL_IGNORE_DEPRECATION_END
 
 				}
@@ -584,8 +799,12 @@ TEXTUAL_IGNORE_DEPRECATION_END
     for (THOPluginItem *plugin in self.allLoadedPlugins)
 	{
 		if ([plugin supportsFeature:THOPluginItemSupportsInlineMediaManipulation]) {
+			uint64_t startTime = mach_absolute_time();
+
             NSString *input = [[plugin primaryClass] processInlineMediaContentURL:resourceCopy];
 
+			[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackProcessInlineMediaContentURL];
+
 			if (input) {
 				NSURL *outputURL = [NSURL URLWithString:input];
 				
@@ -614,8 +833,12 @@ TEXTUAL_IGNORE_DEPRECATION_END
     for (THOPluginItem *plugin in self.allLoadedPlugins)
 	{
 		if ([plugin supportsFeature:THOPluginItemSupportsUserInputDataInterception]) {
+			uint64_t startTime = mach_absolute_time();
+
 			inputCopy = [[plugin primaryClass] interceptUserInput:inputCopy command:commandCopy];
 
+			[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackInterceptUserInput];
+
 			if (inputCopy == nil) {
 				return nil; // Refuse to continue.
 			}
@@ -636,8 +859,12 @@ TEXTUAL_IGNORE_DEPRECATION_END
     for (THOPluginItem *plugin in self.allLoadedPlugins)
 	{
 		if ([plugin supportsFeature:THOPluginItemSupportsServerInputDataInterception]) {
+			uint64_t startTime = mach_absolute_time();
+
 			inputCopy = [[plugin primaryClass] interceptServerInput:inputCopy for:client];
 
+			[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackInterceptServerInput];
+
 			if (inputCopy == nil) {
 				return nil; // Refuse to continue.
 			}
@@ -654,43 +881,112 @@ TEXTUAL_IGNORE_DEPRECATION_END
 	}
 
 	XRPerformBlockAsynchronouslyOnQueue(self.dispatchQueue, ^{
+		BOOL batchMessage = NO;
+
 		for (THOPluginItem *plugin in self.allLoadedPlugins)
 		{
 			if ([plugin supportsFeature:THOPluginItemSupportsNewMessagePostedEvent]) {
-				if ([[plugin primaryClass] respondsToSelector:@selector(didPostNewMessage:forViewController:)]) {
-					[[plugin primaryClass] didPostNewMessage:messageObject forViewController:viewController];
-				} else if ([[plugin primaryClass] respondsToSelector:@selector(didPostNewMessageForViewController:messageInfo:isThemeReload:isHistoryReload:)]) {
-					NSMutableDictionary *pluginDictionary  = [[NSMutableDictionary alloc] initWithCapacity:9];
+				if ([[plugin primaryClass] respondsToSelector:@selector(didPostNewMessages:forViewController:)]) {
+					batchMessage = YES;
+
+					continue;
+				}
+
+				[plugin performBlockOnDispatchQueue:^{
+					uint64_t startTime = mach_absolute_time();
+
+					if ([[plugin primaryClass] respondsToSelector:@selector(didPostNewMessage:forViewController:)]) {
+						[[plugin primaryClass] didPostNewMessage:messageObject forViewController:viewController];
+					} else if ([[plugin primaryClass] respondsToSelector:@selector(didPostNewMessageForViewController:messageInfo:isThemeReload:isHistoryReload:)]) {
+						NSMutableDictionary *pluginDictionary  = [[NSMutableDictionary alloc] initWithCapacity:9];
 
 TEXTUAL_IGNORE_DEPRECATION_BEGIN
-					[pluginDictionary setBool:[messageObject keywordMatchFound] forKey:THOPluginProtocolDidPostNewMessageKeywordMatchFoundAttribute];
+						[pluginDictionary setBool:[messageObject keywordMatchFound] forKey:THOPluginProtocolDidPostNewMessageKeywordMatchFoundAttribute];
 
-					[pluginDictionary setInteger:[messageObject lineType] forKey:THOPluginProtocolDidPostNewMessageLineTypeAttribute];
-					[pluginDictionary setInteger:[messageObject memberType] forKey:THOPluginProtocolDidPostNewMessageMemberTypeAttribute];
+						[pluginDictionary setInteger:[messageObject lineType] forKey:THOPluginProtocolDidPostNewMessageLineTypeAttribute];
+						[pluginDictionary setInteger:[messageObject memberType] forKey:THOPluginProtocolDidPostNewMessageMemberTypeAttribute];
 
-					[pluginDictionary maybeSetObject:[messageObject senderNickname] forKey:THOPluginProtocolDidPostNewMessageSenderNicknameAttribute];
+						[pluginDictionary maybeSetObject:[messageObject senderNickname] forKey:THOPluginProtocolDidPostNewMessageSenderNicknameAttribute];
 
-					[pluginDictionary maybeSetObject:[messageObject receivedAt] forKey:THOPluginProtocolDidPostNewMessageReceivedAtTimeAttribute];
+						[pluginDictionary maybeSetObject:[messageObject receivedAt] forKey:THOPluginProtocolDidPostNewMessageReceivedAtTimeAttribute];
 
-					[pluginDictionary maybeSetObject:[messageObject lineNumber] forKey:THOPluginProtocolDidPostNewMessageLineNumberAttribute];
+						[pluginDictionary maybeSetObject:[messageObject lineNumber] forKey:THOPluginProtocolDidPostNewMessageLineNumberAttribute];
 
-					[pluginDictionary maybeSetObject:[messageObject listOfHyperlinks] forKey:THOPluginProtocolDidPostNewMessageListOfHyperlinksAttribute];
-					[pluginDictionary maybeSetObject:[messageObject listOfUsers] forKey:THOPluginProtocolDidPostNewMessageListOfUsersAttribute];
+						[pluginDictionary maybeSetObject:[messageObject listOfHyperlinks] forKey:THOPluginProtocolDidPostNewMessageListOfHyperlinksAttribute];
+						[pluginDictionary maybeSetObject:[messageObject listOfUsers] forKey:THOPluginProtocolDidPostNewMessageListOfUsersAttribute];
 
-					[pluginDictionary maybeSetObject:[messageObject messageContents] forKey:THOPluginProtocolDidPostNewMessageMessageBodyAttribute];
+						[pluginDictionary maybeSetObject:[messageObject messageContents] forKey:THOPluginProtocolDidPostNewMessageMessageBodyAttribute];
 
-					[[plugin primaryClass] didPostNewMessageForViewController:viewController
-																  messageInfo:[pluginDictionary copy]
-																isThemeReload:[messageObject isProcessedInBulk]
-															  isHistoryReload:[messageObject isProcessedInBulk]];
+						[[plugin primaryClass] didPostNewMessageForViewController:viewController
+																	  messageInfo:[pluginDictionary copy]
+																	isThemeReload:[messageObject isProcessedInBulk]
+																  isHistoryReload:[messageObject isProcessedInBulk]];
 TEXTUAL_IGNORE_DEPRECATION_END
 
-				}
+					}
+
+					[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackDidPostNewMessage];
+				}];
 			}
 		}
+
+		if (batchMessage) {
+			[self addMessageToNewMessageBatch:messageObject forViewController:viewController];
+		}
 	});
 }
 
+- (void)addMessageToNewMessageBatch:(THOPluginDidPostNewMessageConcreteObject *)messageObject forViewController:(TVCLogController *)viewController
+{
+	/* This method is performed on the dispatch queue of the manager. */
+	NSMutableArray *pendingMessages = [self.pendingNewMessageBatches objectForKey:viewController];
+
+	if (pendingMessages == nil) {
+		pendingMessages = [NSMutableArray array];
+
+		[self.pendingNewMessageBatches setObject:pendingMessages forKey:viewController];
+	}
+
+	[pendingMessages addObject:messageObject];
+
+	if (self.newMessageBatchFlushScheduled == NO) {
+		self.newMessageBatchFlushScheduled = YES;
+
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, _newMessageBatchInterval), self.dispatchQueue, ^{
+			[self postPendingNewMessageBatches];
+		});
+	}
+}
+
+- (void)postPendingNewMessageBatches
+{
+	/* This method is performed on the dispatch queue of the manager. */
+	self.newMessageBatchFlushScheduled = NO;
+
+	NSMapTable *pendingBatches = [self.pendingNewMessageBatches copy];
+
+	[self.pendingNewMessageBatches removeAllObjects];
+
+	for (TVCLogController *viewController in pendingBatches) {
+		NSArray *messageObjects = [[pendingBatches objectForKey:viewController] copy];
+
+		for (THOPluginItem *plugin in self.allLoadedPlugins)
+		{
+			if ([plugin supportsFeature:THOPluginItemSupportsNewMessagePostedEvent] &&
+				[[plugin primaryClass] respondsToSelector:@selector(didPostNewMessages:forViewController:)])
+			{
+				[plugin performBlockOnDispatchQueue:^{
+					uint64_t startTime = mach_absolute_time();
+
+					[[plugin primaryClass] didPostNewMessages:messageObjects forViewController:viewController];
+
+					[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackDidPostNewMessages];
+				}];
+			}
+		}
+	}
+}
+
 - (NSString *)postWillRenderMessageEvent:(NSString *)newMessage forViewController:(TVCLogController *)viewController lineType:(TVCLogLineType)lineType memberType:(TVCLogLineMemberType)memberType
 {
 	if (newMessage == nil || viewController == nil) {
@@ -704,8 +1000,12 @@ TEXTUAL_IGNORE_DEPRECATION_END
 	for (THOPluginItem *plugin in self.allLoadedPlugins)
 	{
 		if ([plugin supportsFeature:THOPluginItemSupportsWillRenderMessageEvent]) {
+			uint64_t startTime = mach_absolute_time();
+
 			NSString *pluginResult = [[plugin primaryClass] willRenderMessage:newMessageCopy forViewController:viewController lineType:lineType memberType:memberType];
 
+			[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackWillRenderMessage];
+
 			if (NSObjectIsEmpty(pluginResult)) {
 				;
 			} else {
@@ -738,8 +1038,12 @@ TEXTUAL_IGNORE_DEPRECATION_END
 	for (THOPluginItem *plugin in self.allLoadedPlugins)
 	{
 		if ([plugin supportsFeature:THOPluginItemSupportsDidReceivePlainTextMessageEvent]) {
+			uint64_t startTime = mach_absolute_time();
+
 			BOOL pluginResult = [[plugin primaryClass] receivedText:text authoredBy:textAuthorCopy destinedFor:textDestination asLineType:lineType onClient:client receivedAt:receivedAtCopy wasEncrypted:wasEncrypted];
 
+			[plugin recordLatencySinceTime:startTime forCallback:THOPluginItemCallbackReceivedPlainTextMessage];
+
 			if (pluginResult == NO) {
 				return NO;
 			}
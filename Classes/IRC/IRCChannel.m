@@ -111,8 +111,14 @@ NSString * const IRCChannelConfigurationWasUpdatedNotification = @"IRCChannelCon
 	if (seed) {
 		NSAssertReturn([seed isEqualToChannelConfiguration:self.config] == NO);
 
+		BOOL nameChanged = (NSObjectsAreEqual([seed channelName], [self.config channelName]) == NO);
+
 		[self setConfig:seed]; // Value is copied on assign.
 
+		if (nameChanged) {
+			[self.associatedClient rebuildChannelLookupTables];
+		}
+
 		[self.config writeKeychainItemsToDisk];
 
 		if (updateStoredChannelList) {
@@ -193,6 +199,8 @@ NSString * const IRCChannelConfigurationWasUpdatedNotification = @"IRCChannelCon
 - (void)setName:(NSString *)value
 {
 	[self.config setChannelName:value];
+
+	[self.associatedClient rebuildChannelLookupTables];
 }
 
 - (void)setTopic:(NSString *)topic
@@ -81,6 +81,7 @@
 #import "TextualApplication.h"
 
 #import <objc/message.h>
+#import <malloc/malloc.h>
 
 #define _isonCheckInterval			30
 #define _pingInterval				270
@@ -91,9 +92,17 @@
 
 #define _reconnectTimerMaximumAttempts		100
 
+/* An ISON round that has gone this long without every reply arriving is
+ considered lost. The connection itself is timed out well before then. */
+#define _isonRequestExpiryInterval			(_timeoutInterval * 2)
+
 #define _maximumChannelCountPerWhoBatchRequest		5
 #define _maximumChannelSizePerWhoBatchRequest		5000
 
+/* WHOX replies (354) contain fields in a fixed order regardless of the order
+ they are requested in: <token> <channel> <user> <host> <nick> <flags> <account> */
+#define _whoxRequestFieldsFormat			@"%%tcnuhaf,%@"
+
 enum {
 	ClientIRCv3SupportedCapacitySASLGeneric			= 1 << 9,
 	ClientIRCv3SupportedCapacitySASLPlainText		= 1 << 10, // YES if SASL=plain CAP is supported.
@@ -122,6 +131,7 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 @property (nonatomic, copy) NSString *cachedLocalHostmask;
 @property (nonatomic, copy) NSString *cachedLocalNickname;
 @property (nonatomic, copy) NSString *tryingNicknameSentNickname;
+@property (nonatomic, copy) NSString *whoxRequestToken;
 @property (nonatomic, strong) TLOFileLogger *logFile;
 @property (nonatomic, strong) TLOTimer *isonTimer;
 @property (nonatomic, strong) TLOTimer *pongTimer;
@@ -130,8 +140,16 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 @property (nonatomic, strong) TLOTimer *commandQueueTimer;
 @property (nonatomic, assign) ClientIRCv3SupportedCapacities capacitiesPending;
 @property (nonatomic, strong) NSMutableArray *channels;
+@property (nonatomic, strong) NSMutableDictionary *channelNameLookupTable; // Lowercase name -> IRCChannel
+@property (nonatomic, strong) NSMutableDictionary *channelIdentifierLookupTable; // treeUUID and config UUID -> IRCChannel
 @property (nonatomic, strong) NSMutableArray *commandQueue;
 @property (nonatomic, strong) NSMutableDictionary *trackedUsers;
+@property (nonatomic, strong) NSMutableSet *monitoredUsers; // Lowercase nicknames added using MONITOR +
+@property (nonatomic, strong) NSMutableSet *monitoredUsersPendingInitialStatus; // Lowercase nicknames awaiting first 730/731
+@property (nonatomic, strong) NSMutableArray *isonRequestBatches; // Nicknames sent in each outstanding ISON, oldest first
+@property (nonatomic, assign) CFAbsoluteTime isonRequestBatchesSentAt; // When the outstanding ISON round was sent
+@property (nonatomic, assign) NSInteger isonRequestLateReplyCount; // Replies still owed for ISON batches that expired
+@property (nonatomic, strong) NSHashTable *internedUserStrings; // Weak references to strings shared between IRCUser instances
 @property (nonatomic, weak) IRCChannel *lagCheckDestinationChannel;
 @property (nonatomic, strong) IRCMessageBatchMessageContainer *batchMessages;
 @end
@@ -198,11 +216,23 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 		self.tryingNicknameSentNickname = nil;
 		self.tryingNicknameNumber = -1;
 
+		self.whoxRequestToken = nil;
+
 		self.channels = [NSMutableArray array];
+		self.channelNameLookupTable = [NSMutableDictionary dictionary];
+		self.channelIdentifierLookupTable = [NSMutableDictionary dictionary];
 		self.commandQueue = [NSMutableArray array];
 
 		self.trackedUsers = [NSMutableDictionary dictionary];
 
+		self.monitoredUsers = [NSMutableSet set];
+		self.monitoredUsersPendingInitialStatus = [NSMutableSet set];
+
+		self.isonRequestBatches = [NSMutableArray array];
+		self.isonRequestLateReplyCount = 0;
+
+		self.internedUserStrings = [NSHashTable weakObjectsHashTable];
+
 		self.preAwayNickname = nil;
 
 		self.successfulConnects = 0;
@@ -397,6 +427,8 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 	@synchronized(self.channels) {
 		[self.channels removeAllObjects];
 		[self.channels addObjectsFromArray:newChannelList];
+
+		[self rebuildChannelLookupTables];
 	}
 	
 	/* Reset stored channel list now that we are done. */
@@ -783,6 +815,8 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 					[self.channels addObject:channel];
 				}
 			}
+
+			[self rebuildChannelLookupTables];
 			
 			[self updateStoredChannelList];
 		}
@@ -794,6 +828,8 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 	XRPerformBlockOnSharedMutableSynchronizationDispatchQueue(^{
 		@synchronized(self.channels) {
 			[self.channels insertObject:channel atIndex:pos];
+
+			[self rebuildChannelLookupTables];
 			
 			[self updateStoredChannelList];
 		}
@@ -805,6 +841,8 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 	XRPerformBlockOnSharedMutableSynchronizationDispatchQueue(^{
 		@synchronized(self.channels) {
 			[self.channels removeObjectIdenticalTo:channel];
+
+			[self rebuildChannelLookupTables];
 			
 			[self updateStoredChannelList];
 		}
@@ -855,12 +893,84 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 			[self.channels removeAllObjects];
 			
 			[self.channels addObjectsFromArray:channelList];
+
+			[self rebuildChannelLookupTables];
 			
 			[self updateStoredChannelList];
 		}
 	});
 }
 
+#pragma mark -
+#pragma mark User Storage
+
+- (NSString *)internedUserString:(NSString *)value
+{
+	PointerIsEmptyAssertReturn(value, nil);
+
+	/* A user sitting in many of the same channels as us has a separate
+	 IRCUser instance in each of them. Sharing one copy of each nickname,
+	 username, and address keeps memory proportional to unique users. 
+	 The table holds weak references so unused strings go away. */
+	@synchronized(self.internedUserStrings) {
+		NSString *existingValue = [self.internedUserStrings member:value];
+
+		if (existingValue) {
+			return existingValue;
+		}
+
+		NSString *newValue = [value copy];
+
+		[self.internedUserStrings addObject:newValue];
+
+		return newValue;
+	}
+}
+
+- (NSString *)memberMemoryUsageDiagnostic
+{
+	NSUInteger memberCount = 0;
+	NSUInteger memberBytes = 0;
+
+	NSMutableSet *uniqueUsers = [NSMutableSet set];
+
+	for (IRCChannel *c in [self channelList]) {
+		for (IRCUser *u in [c memberList]) {
+			memberCount += 1;
+
+			memberBytes += [u estimatedMemoryFootprint];
+
+			[uniqueUsers addObject:[u lowercaseNickname]];
+		}
+	}
+
+	NSUInteger stringCount = 0;
+	NSUInteger stringBytes = 0;
+
+	@synchronized(self.internedUserStrings) {
+		for (NSString *value in self.internedUserStrings) {
+			stringCount += 1;
+
+			stringBytes += malloc_size((__bridge const void *)value);
+		}
+	}
+
+	NSUInteger uniqueUserCount = [uniqueUsers count];
+
+	NSUInteger bytesPerMember = 0;
+	NSUInteger bytesPerUniqueUser = 0;
+
+	if (memberCount > 0) {
+		bytesPerMember = ((memberBytes + stringBytes) / memberCount);
+	}
+
+	if (uniqueUserCount > 0) {
+		bytesPerUniqueUser = ((memberBytes + stringBytes) / uniqueUserCount);
+	}
+
+	return BLS(1288, memberCount, uniqueUserCount, stringCount, bytesPerMember, bytesPerUniqueUser);
+}
+
 #pragma mark -
 #pragma mark IRCTreeItem
 
@@ -976,29 +1086,29 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 {
 	NSObjectIsEmptyAssertReturn(raw, NO);
 
-	if ([TPCPreferences removeAllFormatting] == NO) {
-		raw = [raw stripIRCEffects];
+	THOPluginOutputSuppressionRuleScope scope;
+
+	if (chan == nil) {
+		scope = THOPluginOutputSuppressionRuleScopeConsole;
+	} else if ([chan isChannel]) {
+		scope = THOPluginOutputSuppressionRuleScopeChannel;
+	} else if ([chan isPrivateMessage]) {
+		scope = THOPluginOutputSuppressionRuleScopePrivateMessage;
+	} else {
+		return NO;
 	}
 
-	NSArray *rules = [sharedPluginManager() pluginOutputSuppressionRules];
+	/* Most messages have no rules that apply to them so there
+	 is no reason to strip formatting for them. */
+	if ([sharedPluginManager() hasOutputSuppressionRulesForScope:scope] == NO) {
+		return NO;
+	}
 
-	for (THOPluginOutputSuppressionRule *ruleData in rules) {
-		if ([XRRegularExpression string:raw isMatchedByRegex:[ruleData match]]) {
-			if (chan) {
-				if (([chan isChannel] && [ruleData restrictChannel]) ||
-					([chan isPrivateMessage] && [ruleData restrictPrivateMessage]))
-				{
-					return YES;
-				}
-			} else {
-				if ([ruleData restrictConsole]) {
-					return YES;
-				}
-			}
-		}
+	if ([TPCPreferences removeAllFormatting] == NO) {
+		raw = [raw stripIRCEffects];
 	}
 
-	return NO;
+	return [sharedPluginManager() outputSuppressionRulesMatchMessage:raw inScope:scope];
 }
 
 #pragma mark -
@@ -1598,8 +1708,51 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 
 - (IRCChannel *)findChannel:(NSString *)name
 {
+	NSObjectIsEmptyAssertReturn(name, nil);
+
+	@synchronized(self.channels) {
+		return self.channelNameLookupTable[[name lowercaseString]];
+	}
+}
+
+- (IRCChannel *)findChannelByIdentifier:(NSString *)identifier
+{
+	NSObjectIsEmptyAssertReturn(identifier, nil);
+
 	@synchronized(self.channels) {
-		return [self findChannel:name inList:self.channels];
+		return self.channelIdentifierLookupTable[identifier];
+	}
+}
+
+- (void)rebuildChannelLookupTables
+{
+	/* The lookup tables mirror self.channels so that finding a channel
+	 by name or identifier does not require scanning the entire list.
+	 They are rebuilt any time the list is modified or a channel is
+	 renamed. When duplicate names exist, the first in the list wins
+	 which matches the behavior of -findChannel:inList: */
+	@synchronized(self.channels) {
+		[self.channelNameLookupTable removeAllObjects];
+		[self.channelIdentifierLookupTable removeAllObjects];
+
+		for (IRCChannel *c in self.channels) {
+			NSString *lowercaseName = [c.name lowercaseString];
+
+			if (lowercaseName && self.channelNameLookupTable[lowercaseName] == nil) {
+				self.channelNameLookupTable[lowercaseName] = c;
+			}
+
+			NSString *treeUUID = [c treeUUID];
+			NSString *uniqueIdentifier = [c uniqueIdentifier];
+
+			if (treeUUID) {
+				self.channelIdentifierLookupTable[treeUUID] = c;
+			}
+
+			if (uniqueIdentifier) {
+				self.channelIdentifierLookupTable[uniqueIdentifier] = c;
+			}
+		}
 	}
 }
 
@@ -3022,6 +3175,28 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 
 			break;
 		}
+		case 5103: // Command: MEMBER_MEMORY
+		{
+			/* Member list memory usage — Developer mode only. */
+			[self printDebugInformation:[self memberMemoryUsageDiagnostic]];
+
+			break;
+		}
+		case 5104: // Command: PLUGIN_LATENCY
+		{
+			/* Plugin callback latency — Developer mode only. */
+			NSArray *reportLines = [sharedPluginManager() pluginLatencyReport];
+
+			if (NSObjectIsEmpty(reportLines)) {
+				[self printDebugInformation:BLS(1291)];
+			} else {
+				for (NSString *reportLine in reportLines) {
+					[self printDebugInformation:reportLine];
+				}
+			}
+
+			break;
+		}
 		case 5084: // Command: LAGCHECK
 		case 5045: // Command: MYLAG
 		{
@@ -3815,7 +3990,12 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 	self.lastLagCheck = 0;
 	
 	self.lastWhoRequestChannelListIndex = 0;
-	
+
+	/* WHOX tokens are limited to three digits. A new token is chosen for each
+	 connection so that replies to requests made by the user (or a script)
+	 are not mistaken for our own. */
+	self.whoxRequestToken = [NSString stringWithFormat:@"%u", (100 + arc4random_uniform(900))];
+
 	self.cachedLocalHostmask = nil;
 	self.cachedLocalNickname = self.config.nickname;
 	
@@ -5799,6 +5979,18 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 			
 			break;
 		}
+		case ClientIRCv3SupportedCapacityWHOXCommand:
+		{
+			stringValue = @"whox-command";
+
+			break;
+		}
+		case ClientIRCv3SupportedCapacityMonitorCommand:
+		{
+			stringValue = @"monitor-command";
+
+			break;
+		}
 		case ClientIRCv3SupportedCapacityZNCPlaybackModule:
 		{
 			stringValue = @"znc.in/playback";
@@ -6791,11 +6983,54 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 				
 				NSArray *users = [userInfo split:NSStringWhitespacePlaceholder];
 
+				/* ISON requests are split over several lines so each reply only
+				 speaks for the nicknames that were sent in its matching request.
+				 Replies arrive in the same order the requests were sent. */
+				NSArray *requestedUsers = nil;
+
+				BOOL isLateReply = NO;
+
+				@synchronized(self.isonRequestBatches) {
+					if (self.isonRequestLateReplyCount > 0) {
+						/* Replies to batches that expired arrive before any reply to
+						 the round that replaced them. They are no longer wanted. */
+						self.isonRequestLateReplyCount -= 1;
+
+						isLateReply = YES;
+					} else if ([self.isonRequestBatches count] > 0) {
+						requestedUsers = self.isonRequestBatches[0];
+
+						/* A reply only names nicknames that were asked about. One
+						 that names anyone else cannot belong to this batch. */
+						for (NSString *user in users) {
+							if ([requestedUsers containsObjectIgnoringCase:user] == NO) {
+								isLateReply = YES;
+
+								break;
+							}
+						}
+
+						if (isLateReply == NO) {
+							[self.isonRequestBatches removeObjectAtIndex:0];
+						}
+					}
+				}
+
+				if (isLateReply) {
+					LogToConsole(@"Ignoring an ISON reply that does not belong to the outstanding batch");
+
+					break;
+				}
+
 				/* Start going over the list of tracked nicknames. */
 				@synchronized(self.trackedUsers) {
 					NSArray *trackedUsers = [self.trackedUsers allKeys];
 					
 					for (NSString *name in trackedUsers) {
+						if (requestedUsers && [requestedUsers containsObjectIgnoringCase:name] == NO) {
+							continue;
+						}
+
 						NSInteger langKey = 0;
 						
 						/* Was the user on during the last check? */
@@ -6840,13 +7075,21 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 				}
 
 				if (self.isInvokingISONCommandForFirstTime) { // Reset internal var.
-					self.isInvokingISONCommandForFirstTime = NO;
+					@synchronized(self.isonRequestBatches) {
+						if ([self.isonRequestBatches count] == 0) {
+							self.isInvokingISONCommandForFirstTime = NO;
+						}
+					}
 				}
 
 				/* Update private messages. */
 				@synchronized(self.channels) {
 					for (IRCChannel *channel in self.channels) {
 						if ([channel isPrivateMessage]) {
+							if (requestedUsers && [requestedUsers containsObjectIgnoringCase:[channel name]] == NO) {
+								continue;
+							}
+
 							if ([channel isActive]) {
 								/* If the user is no longer on, deactivate the private message. */
 								if ([users containsObjectIgnoringCase:[channel name]] == NO) {
@@ -6966,21 +7209,9 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 			[newUser setRealname:realname];
 
 			/* Update user modes */
-			NSMutableString *userModes = [NSMutableString string];
-
-			for (NSUInteger i = 0; i < [flfields length]; i++) {
-				NSString *prefix = [flfields stringCharacterAtIndex:i];
+			NSString *userModes = [self.supportInfo userModesFromPrefixSymbolsInString:flfields prefixLength:NULL];
 
-				NSString *mode = [self.supportInfo modeCharacterFromUserPrefixSymbol:prefix];
-
-				if (mode == nil) {
-					break;
-				} else {
-					[userModes appendString:mode];
-				}
-			}
-
-			if ([userModes length] > 0) {
+			if (userModes) {
 				[newUser setModes:userModes];
 			}
 
@@ -7010,6 +7241,39 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 
 			break;
 		}
+		case 354: // RPL_WHOSPCRPL
+		{
+			/* Example incoming data (requested using %tcnuhaf):
+				<token> <channel> <user> <host> <nick> <H|G>[*][@|+] <account>
+
+				123 #freenode ~D unaffiliated/solprefixer solprefixer H solprefixer
+			 */
+			NSAssertReturnLoopBreak([m paramsCount] > 6);
+
+			NSString *token = [m paramAt:1];
+
+			/* Replies without our token were requested by someone else. 
+			 Those are printed, but do not modify any state. */
+			if (self.whoxRequestToken == nil || NSObjectsAreEqual(token, self.whoxRequestToken) == NO) {
+				[self printUnknownReply:m];
+
+				break;
+			}
+
+			NSString *channel = [m paramAt:2];
+			NSString *username = [m paramAt:3];
+			NSString *hostmask = [m paramAt:4];
+			NSString *nickname = [m paramAt:5];
+			NSString *flfields = [m paramAt:6];
+
+			IRCChannel *c = [self findChannel:channel];
+
+			PointerIsEmptyAssertLoopBreak(c);
+
+			[self updateMember:nickname inChannel:c withUsername:username address:hostmask flags:flfields];
+
+			break;
+		}
 		case 353: // RPL_NAMEREPLY
 		{
 			NSAssertReturnLoopBreak([m paramsCount] > 3);
@@ -7032,24 +7296,12 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 				
 				IRCUser *member = [IRCUser newUserOnClient:self withNickname:nil];
 
-				NSUInteger i;
+				NSUInteger i = 0;
 				
 				/* Find first character that is not mode prefix. */
-				NSMutableString *userModes = [NSMutableString string];
+				NSString *userModes = [self.supportInfo userModesFromPrefixSymbolsInString:nickname prefixLength:&i];
 
-				for (i = 0; i < [nickname length]; i++) {
-					NSString *prefix = [nickname stringCharacterAtIndex:i];
-
-					NSString *mode = [self.supportInfo modeCharacterFromUserPrefixSymbol:prefix];
-
-					if (mode == nil) {
-						break;
-					} else {
-						[userModes appendString:mode];
-					}
-				}
-
-				if ([userModes length] > 0) {
+				if (userModes) {
 					[member setModes:userModes];
 				}
 				
@@ -7394,6 +7646,58 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 
 			break;
 		}
+		case 730: // RPL_MONONLINE
+		case 731: // RPL_MONOFFLINE
+		{
+			NSAssertReturnLoopBreak([m paramsCount] > 1);
+
+			/* 730 lists targets as nickname!username@address.
+			 731 lists targets using only their nickname. */
+			NSArray *targets = [[m paramAt:1] split:@","];
+
+			for (NSString *target in targets) {
+				NSObjectIsEmptyAssertLoopContinue(target);
+
+				NSString *nickname = target;
+				NSString *hostmask = nil;
+
+				if ([target isHostmask]) {
+					nickname = [target nicknameFromHostmask];
+
+					hostmask = target;
+				} else {
+					hostmask = [target stringByAppendingString:@"!-@-"];
+				}
+
+				[self monitoredUserChangedStatus:nickname hostmask:hostmask isOnline:(n == 730)];
+			}
+
+			break;
+		}
+		case 732: // RPL_MONLIST
+		case 733: // RPL_ENDOFMONLIST
+		{
+			break;
+		}
+		case 734: // ERR_MONLISTFULL
+		{
+			NSAssertReturnLoopBreak([m paramsCount] > 2);
+
+			/* Targets that did not fit in the server side list are 
+			 polled using ISON instead. */
+			NSArray *targets = [[m paramAt:2] split:@","];
+
+			@synchronized(self.monitoredUsers) {
+				for (NSString *target in targets) {
+					NSString *lowercaseTarget = [target lowercaseString];
+
+					[self.monitoredUsers removeObject:lowercaseTarget];
+					[self.monitoredUsersPendingInitialStatus removeObject:lowercaseTarget];
+				}
+			}
+
+			break;
+		}
 		case 716: // RPL_TARGUMODEG
 		{
 			// Ignore, 717 will take care of notification.
@@ -8903,8 +9207,11 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 - (void)populateISONTrackedUsersList:(NSArray *)ignores
 {
     NSAssertReturn(self.isLoggedIn);
+
+	/* MONITOR is favored over WATCH when a server supports both. */
+	BOOL useMonitorCommand = [self isCapacityEnabled:ClientIRCv3SupportedCapacityMonitorCommand];
 	
-	BOOL useWatchCommand = [self isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand];
+	BOOL useWatchCommand = ([self isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand] && useMonitorCommand == NO);
 
 	BOOL populatingForFirstTime = NO;
 	
@@ -8989,6 +9296,8 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 
 			[self send:IRCPrivateCommandIndex("watch"), [@"-" stringByAppendingString:delString], nil];
 		}
+	} else if (useMonitorCommand) {
+		[self updateMonitoredUsersWithTrackedUsers:[newEntries allKeys]];
 	}
 
 	/* Finish up. */
@@ -9017,13 +9326,265 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 	@synchronized(self.trackedUsers) {
 		[self.trackedUsers removeAllObjects];
 	}
+
+	@synchronized(self.monitoredUsers) {
+		[self.monitoredUsers removeAllObjects];
+		[self.monitoredUsersPendingInitialStatus removeAllObjects];
+	}
+
+	@synchronized(self.isonRequestBatches) {
+		[self.isonRequestBatches removeAllObjects];
+
+		self.isonRequestLateReplyCount = 0;
+	}
+}
+
+- (void)updateMonitoredUsersWithTrackedUsers:(NSArray *)trackedUsers
+{
+	NSMutableArray *monitorAdditions = [NSMutableArray array];
+	NSMutableArray *monitorRemovals = [NSMutableArray array];
+
+	@synchronized(self.monitoredUsers) {
+		NSMutableSet *lowercaseTrackedUsers = [NSMutableSet setWithCapacity:[trackedUsers count]];
+
+		for (NSString *lname in trackedUsers) {
+			[lowercaseTrackedUsers addObject:[lname lowercaseString]];
+		}
+
+		/* Removals are processed first so that their slots can be
+		 reused by additions when the server imposes a limit. */
+		for (NSString *lname in [self.monitoredUsers allObjects]) {
+			if ([lowercaseTrackedUsers containsObject:lname] == NO) {
+				[monitorRemovals addObject:lname];
+
+				[self.monitoredUsers removeObject:lname];
+				[self.monitoredUsersPendingInitialStatus removeObject:lname];
+			}
+		}
+
+		NSInteger targetLimit = [self.supportInfo monitorTargetLimit];
+
+		for (NSString *lname in lowercaseTrackedUsers) {
+			if ([self.monitoredUsers containsObject:lname]) {
+				continue;
+			}
+
+			/* Anything that does not fit is left to ISON polling. */
+			if (targetLimit > 0 && [self.monitoredUsers count] >= targetLimit) {
+				break;
+			}
+
+			[monitorAdditions addObject:lname];
+
+			[self.monitoredUsers addObject:lname];
+			[self.monitoredUsersPendingInitialStatus addObject:lname];
+		}
+	}
+
+	NSString *monitorCommand = IRCPrivateCommandIndex("monitor");
+
+	for (NSArray *batch in [self batchesOfNicknames:monitorRemovals separator:@"," linePrefixLength:([monitorCommand length] + 3)]) {
+		[self send:monitorCommand, @"-", [batch componentsJoinedByString:@","], nil];
+	}
+
+	for (NSArray *batch in [self batchesOfNicknames:monitorAdditions separator:@"," linePrefixLength:([monitorCommand length] + 3)]) {
+		[self send:monitorCommand, @"+", [batch componentsJoinedByString:@","], nil];
+	}
+}
+
+- (void)monitoredUserChangedStatus:(NSString *)nickname hostmask:(NSString *)hostmask isOnline:(BOOL)isOnline
+{
+	NSObjectIsEmptyAssert(nickname);
+
+	IRCAddressBookEntry *ignoreChecks = [self checkIgnoreAgainstHostmask:hostmask withMatches:@[IRCAddressBookDictionaryValueTrackUserActivityKey]];
+
+	PointerIsEmptyAssert(ignoreChecks);
+
+	NSString *lowercaseNickname = [nickname lowercaseString];
+
+	BOOL isInitialStatus = NO;
+
+	@synchronized(self.monitoredUsers) {
+		if ([self.monitoredUsersPendingInitialStatus containsObject:lowercaseNickname]) {
+			[self.monitoredUsersPendingInitialStatus removeObject:lowercaseNickname];
+
+			isInitialStatus = YES;
+		}
+	}
+
+	NSInteger langKey = 0;
+
+	@synchronized(self.trackedUsers) {
+		NSString *tracker = [ignoreChecks trackingNickname];
+
+		BOOL ison = [self.trackedUsers boolForKey:tracker];
+
+		/* The first reply after MONITOR + is the current status rather
+		 than a change in status. Treat it as ISON does on first use. */
+		if (isInitialStatus) {
+			if (isOnline) {
+				langKey = 1083;
+			}
+		} else if (NSDissimilarObjects(ison, isOnline)) {
+			if (isOnline) {
+				langKey = 1085;
+			} else {
+				langKey = 1084;
+			}
+		}
+
+		[self.trackedUsers setBool:isOnline forKey:tracker];
+	}
+
+	if (langKey > 0) {
+		[self handleUserTrackingNotification:ignoreChecks nickname:nickname langitem:langKey];
+	}
+}
+
+- (NSArray *)batchesOfNicknames:(NSArray *)nicknames separator:(NSString *)separator linePrefixLength:(NSUInteger)prefixLength
+{
+	/* Split a list of nicknames into groups that each fit on a single line
+	 once the command and its separators are accounted for. */
+	NSMutableArray *batches = [NSMutableArray array];
+
+	NSMutableArray *currentBatch = [NSMutableArray array];
+
+	NSUInteger separatorLength = [separator lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+	NSUInteger maximumLength = (TXMaximumIRCBodyLength - prefixLength);
+
+	NSUInteger currentLength = 0;
+
+	for (NSString *nickname in nicknames) {
+		NSUInteger nicknameLength = [nickname lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+		NSUInteger requiredLength = nicknameLength;
+
+		if ([currentBatch count] > 0) {
+			requiredLength += separatorLength;
+		}
+
+		if ((currentLength + requiredLength) > maximumLength && [currentBatch count] > 0) {
+			[batches addObject:currentBatch];
+
+			currentBatch = [NSMutableArray array];
+
+			currentLength = 0;
+
+			requiredLength = nicknameLength;
+		}
+
+		[currentBatch addObject:nickname];
+
+		currentLength += requiredLength;
+	}
+
+	if ([currentBatch count] > 0) {
+		[batches addObject:currentBatch];
+	}
+
+	return batches;
+}
+
+- (void)updateMember:(NSString *)nickname inChannel:(IRCChannel *)channel withUsername:(NSString *)username address:(NSString *)address flags:(NSString *)flags
+{
+	NSObjectIsEmptyAssert(nickname);
+	NSObjectIsEmptyAssert(flags);
+
+	/* Unlike the handler for RPL_WHOREPLY, this method never copies a user.
+	 The existing instance is modified. Changes that only affect the appearance
+	 of a user redraw that row. The modes and IRCop status of a user decide its
+	 position in the member list so the user is removed from the list before
+	 those are changed and inserted back into it afterwards. */
+	IRCUser *user = [channel findMember:nickname];
+
+	if (user == nil) {
+		user = [IRCUser newUserOnClient:self withNickname:nickname];
+
+		[user setUsername:username];
+		[user setAddress:address];
+
+		[channel addMember:user];
+	}
+
+	BOOL isAway = NO;
+	BOOL isIRCop = NO;
+
+	// Field Syntax: <H|G>[*][@|+]
+	if ([flags hasPrefix:@"G"]) {
+		if ([TPCPreferences trackUserAwayStatusMaximumChannelSize] > 0 || [self isCapacityEnabled:ClientIRCv3SupportedCapacityAwayNotify]) {
+			isAway = YES;
+		}
+	}
+
+	NSString *prefixes = [flags substringFromIndex:1];
+
+	if ([prefixes hasPrefix:@"*"]) {
+		prefixes = [prefixes substringFromIndex:1];
+
+		isIRCop = YES;
+	}
+
+	NSString *userModes = [self.supportInfo userModesFromPrefixSymbolsInString:prefixes prefixLength:NULL];
+
+	if (userModes == nil) {
+		userModes = NSStringEmptyPlaceholder;
+	}
+
+	BOOL requiresRedraw = NO;
+	BOOL requiresReinsert = NO;
+
+	if (NSObjectsAreEqual([user username], username) == NO) {
+		[user setUsername:username];
+	}
+
+	if (NSObjectsAreEqual([user address], address) == NO) {
+		[user setAddress:address];
+	}
+
+	if (NSDissimilarObjects([user isAway], isAway)) {
+		[user setIsAway:isAway];
+
+		requiresRedraw = YES;
+	}
+
+	if (NSDissimilarObjects([user isCop], isIRCop)) {
+		requiresReinsert = YES;
+	}
+
+	if ([userModes length] > 0 && NSObjectsAreEqual([user modes], userModes) == NO) {
+		requiresReinsert = YES;
+	}
+
+	if (requiresReinsert) {
+		[channel removeMember:[user nickname]];
+
+		[user setIsCop:isIRCop];
+
+		if ([userModes length] > 0) {
+			[user setModes:userModes];
+		}
+
+		[channel addMember:user];
+	}
+
+	/* Update local cache of our hostmask. */
+	if ([nickname isEqualIgnoringCase:[self localNickname]]) {
+		self.cachedLocalHostmask = [NSString stringWithFormat:@"%@!%@@%@", nickname, username, address];
+	}
+
+	if (requiresRedraw && requiresReinsert == NO) {
+		XRPerformBlockSynchronouslyOnMainQueue(^{
+			[channel updateMemberOnTableView:user];
+		});
+	}
 }
 
 - (void)onISONTimer:(id)sender
 {
     NSAssertReturn(self.isLoggedIn);
 
-    NSMutableString *userstr = [NSMutableString string];
+	NSMutableArray *isonUsers = [NSMutableArray array];
 
 	/* Given all channels, we build a list of users if a channel is private message.
 	 If a channel is an actual channel and it meets certain conditions, then we send
@@ -9071,42 +9632,108 @@ NSString * const IRCClientChannelListWasModifiedNotification = @"IRCClientChanne
 			}
 		}
 		
+		BOOL useWHOXCommand = [self isCapacityEnabled:ClientIRCv3SupportedCapacityWHOXCommand];
+
 		for (IRCChannel *c in channelBatch) {
-			[self send:IRCPrivateCommandIndex("who"), [c name], nil];
+			if (useWHOXCommand) {
+				NSString *whoxFields = [NSString stringWithFormat:_whoxRequestFieldsFormat, self.whoxRequestToken];
+
+				[self send:IRCPrivateCommandIndex("who"), [c name], whoxFields, nil];
+			} else {
+				[self send:IRCPrivateCommandIndex("who"), [c name], nil];
+			}
 		}
 		
 		for (IRCChannel *channel in self.channels) {
 			if ([channel isPrivateMessage]) {
-				[userstr appendFormat:@" %@", [channel name]];
+				[isonUsers addObjectWithoutDuplication:[channel name]];
 			}
 		}
 	}
 
-	/* If there is no WATCH command, then we populate ISON list. */
-	if ([self isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand] == NO) {
+	/* Tracked users are only polled when the server will not tell us about
+	 them. That is when there is no WATCH command or when they did not fit
+	 in the list maintained by the MONITOR command. */
+	BOOL useMonitorCommand = [self isCapacityEnabled:ClientIRCv3SupportedCapacityMonitorCommand];
+
+	BOOL useWatchCommand = ([self isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand] && useMonitorCommand == NO);
+
+	if (useWatchCommand == NO) {
 		@synchronized(self.trackedUsers) {
 			for (NSString *name in self.trackedUsers) {
-				[userstr appendFormat:@" %@", name];
+				if (useMonitorCommand) {
+					@synchronized(self.monitoredUsers) {
+						if ([self.monitoredUsers containsObject:[name lowercaseString]]) {
+							continue;
+						}
+					}
+				}
+
+				if ([isonUsers containsObjectIgnoringCase:name] == NO) {
+					[isonUsers addObject:name];
+				}
 			}
 		}
 	}
 
-	/* We send a ISON request to track private messages as well as tracked users. */
-	NSObjectIsEmptyAssert(userstr);
+	/* We send ISON requests to track private messages as well as tracked users.
+	 The list is split over as many lines as needed to stay within the maximum
+	 line length. Each batch is remembered so that the reply for it can be 
+	 compared against only the nicknames it asked about. */
+	NSObjectIsEmptyAssert(isonUsers);
+
+	NSString *isonCommand = IRCPrivateCommandIndex("ison");
+
+	NSArray *isonBatches = [self batchesOfNicknames:isonUsers separator:NSStringWhitespacePlaceholder linePrefixLength:([isonCommand length] + 2)];
+
+	@synchronized(self.isonRequestBatches) {
+		/* Replies are matched to batches by order alone so a new round is not
+		 sent until every reply to the previous one has arrived. Otherwise a
+		 late reply would be compared against the wrong batch. */
+		if ([self.isonRequestBatches count] > 0) {
+			CFAbsoluteTime outstandingFor = (CFAbsoluteTimeGetCurrent() - self.isonRequestBatchesSentAt);
+
+			if (outstandingFor < _isonRequestExpiryInterval) {
+				return;
+			}
+
+			LogToConsole(@"Discarding %ld ISON batches that went unanswered for %.0f seconds", (long)[self.isonRequestBatches count], outstandingFor);
+
+			/* Replies to these may still arrive. They are counted so that
+			 they are not compared against the batches of the next round. */
+			self.isonRequestLateReplyCount += [self.isonRequestBatches count];
 
-    [self send:IRCPrivateCommandIndex("ison"), userstr, nil];
+			[self.isonRequestBatches removeAllObjects];
+		}
+
+		[self.isonRequestBatches addObjectsFromArray:isonBatches];
+
+		self.isonRequestBatchesSentAt = CFAbsoluteTimeGetCurrent();
+	}
+
+	for (NSArray *batch in isonBatches) {
+		[self send:isonCommand, [batch componentsJoinedByString:NSStringWhitespacePlaceholder], nil];
+	}
 }
 
 - (void)checkAddressBookForTrackedUser:(IRCAddressBookEntry *)abEntry inMessage:(IRCMessage *)message
 {
     PointerIsEmptyAssert(abEntry);
 
-	if ([self isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand]) {
+	if ([self isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand] &&
+		[self isCapacityEnabled:ClientIRCv3SupportedCapacityMonitorCommand] == NO)
+	{
 		return; // Nothing to do here.
 	}
 	
     NSString *tracker = [abEntry trackingNickname];
 
+	@synchronized(self.monitoredUsers) {
+		if ([self.monitoredUsers containsObject:[tracker lowercaseString]]) {
+			return; // The server will inform us of changes using RPL_MONONLINE and RPL_MONOFFLINE.
+		}
+	}
+
 	@synchronized(self.trackedUsers) {
 		BOOL ison = [self.trackedUsers boolForKey:tracker];
 		
@@ -40,8 +40,21 @@
 
 #define _channelUserModeValue		100
 
+#define _lookupTableSize			IRCISupportLookupTableSize
+
 NSString * const IRCISupportRawSuffix = @"are supported by this server";
 
+@interface IRCISupportInfo ()
+{
+	/* Indexed by ASCII value. A value of zero means no entry. */
+	UniChar _userPrefixSymbolToModeTable[_lookupTableSize];
+	UniChar _userPrefixModeToSymbolTable[_lookupTableSize];
+	NSInteger _userPrefixModeRankTable[_lookupTableSize];
+	IRCISupportChannelModeParameterType _channelModeParameterTypeTable[_lookupTableSize];
+	BOOL _channelNamePrefixTable[_lookupTableSize];
+}
+@end
+
 @implementation IRCISupportInfo
 
 - (instancetype)init
@@ -67,6 +80,8 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 	self.nicknameLength = IRCProtocolDefaultNicknameMaximumLength;
 	self.modesCount = TXMaximumNodesPerModeCommand;
 
+	self.monitorTargetLimit = 0;
+
 	self.userModePrefixes = @[
 		@[@"o", @"@"],
 		@[@"v", @"+"]
@@ -118,6 +133,8 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 				self.nicknameLength = [value integerValue];
 			} else if ([vakey isEqualIgnoringCase:@"MODES"]) {
 				self.modesCount = [value integerValue];
+			} else if ([vakey isEqualIgnoringCase:@"MONITOR"]) {
+				self.monitorTargetLimit = [value integerValue];
 			} else if ([vakey isEqualIgnoringCase:@"NETWORK"]) {
 				self.networkName = value;
 				self.networkNameFormatted = BLS(1151, value);
@@ -132,6 +149,14 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 			if ([client isCapacityEnabled:ClientIRCv3SupportedCapacityWatchCommand] == NO) {
 				[client enableCapacity:ClientIRCv3SupportedCapacityWatchCommand];
 			}
+		} else if ([vakey isEqualIgnoringCase:@"MONITOR"]) {
+			if ([client isCapacityEnabled:ClientIRCv3SupportedCapacityMonitorCommand] == NO) {
+				[client enableCapacity:ClientIRCv3SupportedCapacityMonitorCommand];
+			}
+		} else if ([vakey isEqualIgnoringCase:@"WHOX"]) {
+			if ([client isCapacityEnabled:ClientIRCv3SupportedCapacityWHOXCommand] == NO) {
+				[client enableCapacity:ClientIRCv3SupportedCapacityWHOXCommand];
+			}
 		} else if ([vakey isEqualIgnoringCase:@"NAMESX"]) {
 			if ([client isCapacityEnabled:ClientIRCv3SupportedCapacityMultiPreifx] == NO) {
 				[client sendLine:@"PROTOCTL NAMESX"];
@@ -202,24 +227,24 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 
 		NSObjectIsEmptyAssertLoopBreak(token);
 
-		NSString *c = [token stringCharacterAtIndex:0];
+		UniChar c = [token characterAtIndex:0];
 		
-		if ([c isEqualToString:@"+"] || [c isEqualToString:@"-"]) {
-			beingSet = [c isEqualToString:@"+"];
-			
-			token = [token substringFromIndex:1];
+		if (c == '+' || c == '-') {
+			beingSet = (c == '+');
 			
-			for (NSUInteger i = 0; i < [token length]; i++) {
-				c = [token stringCharacterAtIndex:i];
+			NSUInteger tokenLength = [token length];
 
-				if ([c isEqualToString:@"-"]) {
+			for (NSUInteger i = 1; i < tokenLength; i++) {
+				c = [token characterAtIndex:i];
+
+				if (c == '-') {
 					beingSet = NO;
-				} else if ([c isEqualToString:@"+"]) {
+				} else if (c == '+') {
 					beingSet = YES;
 				} else {
 					IRCModeInfo *m = [IRCModeInfo modeInfo];
 
-					m.modeToken = c;
+					m.modeToken = [NSString stringWithCharacters:&c length:1];
 					m.modeIsSet = beingSet;
 					
 					if ([self hasParamForMode:c isSet:beingSet]) {
@@ -270,7 +295,7 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 	}
 }
 
-- (BOOL)hasParamForMode:(NSString *)m isSet:(BOOL)modeIsSet
+- (BOOL)hasParamForMode:(UniChar)m isSet:(BOOL)modeIsSet
 {
 	// Input: CHANMODES=A,B,C,D
 	//
@@ -279,11 +304,14 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 	// C = Only has a paramater when set.	Index: 3
 	// D = Never has a paramater.			Index: 4
 
-	NSInteger modeIndex = [self.channelModes integerForKey:m];
+	IRCISupportChannelModeParameterType modeIndex = [self parameterTypeForChannelMode:m];
 
-	if (modeIndex == 1 || modeIndex == 2 || modeIndex == _channelUserModeValue) {
+	if (modeIndex == IRCISupportChannelModeParameterListType ||
+		modeIndex == IRCISupportChannelModeParameterAlwaysType ||
+		modeIndex == IRCISupportChannelModeParameterUserPrefixType)
+	{
 		return YES;
-	} else if (modeIndex == 3) {
+	} else if (modeIndex == IRCISupportChannelModeParameterWhenSetType) {
 		return modeIsSet;
 	} else {
 		return NO;
@@ -316,79 +344,234 @@ NSString * const IRCISupportRawSuffix = @"are supported by this server";
 	self.channelModes = channelModes;
 }
 
-- (NSString *)userModePrefixSymbolWithMode:(NSString *)mode
+#pragma mark -
+#pragma mark Lookup Tables
+
+#define _characterIsInTableRange(c)			((c) > 0 && (c) < _lookupTableSize)
+
+- (void)setUserModePrefixes:(NSArray *)userModePrefixes
 {
-	__block NSString *charr = nil;
+	_userModePrefixes = [userModePrefixes copy];
+
+	memset(_userPrefixSymbolToModeTable, 0, sizeof(_userPrefixSymbolToModeTable));
+	memset(_userPrefixModeToSymbolTable, 0, sizeof(_userPrefixModeToSymbolTable));
+	memset(_userPrefixModeRankTable, 0, sizeof(_userPrefixModeRankTable));
 
-	[self.userModePrefixes enumerateObjectsUsingBlock:^(NSArray *obj, NSUInteger idx, BOOL *stop) {
-		if (NSObjectsAreEqual(obj[0], mode)) {
-			charr = [obj[1] copy];
+	/* Ranks start at 100 for the first prefix and count down. When a mode
+	 or symbol appears more than once, the first appearance wins to match
+	 the behavior of searching the array from the start. */
+	NSInteger rankValue = _channelUserModeValue;
 
-			*stop = YES;
+	for (NSArray *prefix in _userModePrefixes) {
+		NSString *modeString = prefix[0];
+		NSString *symbolString = prefix[1];
+
+		if ([modeString length] == 1 && [symbolString length] == 1) {
+			UniChar mode = [modeString characterAtIndex:0];
+			UniChar symbol = [symbolString characterAtIndex:0];
+
+			if (_characterIsInTableRange(mode) && _characterIsInTableRange(symbol)) {
+				if (_userPrefixSymbolToModeTable[symbol] == 0) {
+					_userPrefixSymbolToModeTable[symbol] = mode;
+				}
+
+				if (_userPrefixModeToSymbolTable[mode] == 0) {
+					_userPrefixModeToSymbolTable[mode] = symbol;
+
+					_userPrefixModeRankTable[mode] = rankValue;
+				}
+			}
 		}
-	}];
 
-	return charr;
+		rankValue -= 1;
+	}
 }
 
-- (BOOL)modeIsSupportedUserPrefix:(NSString *)mode
+- (void)setChannelModes:(NSDictionary *)channelModes
 {
-	id prefix = [self userModePrefixSymbolWithMode:mode];
-	
-	return ((prefix == nil) == NO);
+	_channelModes = [channelModes copy];
+
+	memset(_channelModeParameterTypeTable, 0, sizeof(_channelModeParameterTypeTable));
+
+	for (NSString *modeString in _channelModes) {
+		if ([modeString length] == 1) {
+			UniChar mode = [modeString characterAtIndex:0];
+
+			if (_characterIsInTableRange(mode)) {
+				_channelModeParameterTypeTable[mode] = [_channelModes integerForKey:modeString];
+			}
+		}
+	}
 }
 
-- (NSString *)modeCharacterFromUserPrefixSymbol:(NSString *)symbol
+- (void)setChannelNamePrefixes:(NSString *)channelNamePrefixes
 {
-	__block NSString *mode = nil;
+	_channelNamePrefixes = [channelNamePrefixes copy];
+
+	/* The table is rebuilt under the same lock it is copied under so
+	 that a copy is never taken of a table that is half rebuilt. */
+	@synchronized(self) {
+		memset(_channelNamePrefixTable, 0, sizeof(_channelNamePrefixTable));
 
-	[self.userModePrefixes enumerateObjectsUsingBlock:^(NSArray *obj, NSUInteger idx, BOOL *stop) {
-		if (NSObjectsAreEqual(obj[1], symbol)) {
-			mode = [obj[0] copy];
+		for (NSUInteger i = 0; i < [_channelNamePrefixes length]; i++) {
+			UniChar c = [_channelNamePrefixes characterAtIndex:i];
 
-			*stop = YES;
+			if (_characterIsInTableRange(c)) {
+				_channelNamePrefixTable[c] = YES;
+			}
 		}
-	}];
+	}
+}
 
-	return mode;
+- (UniChar)modeForUserPrefixSymbol:(UniChar)symbol
+{
+	if (_characterIsInTableRange(symbol)) {
+		return _userPrefixSymbolToModeTable[symbol];
+	} else {
+		return 0;
+	}
 }
 
-- (BOOL)symbolIsUserPrefixCharacter:(NSString *)symbol
+- (UniChar)userPrefixSymbolForMode:(UniChar)mode
+{
+	if (_characterIsInTableRange(mode)) {
+		return _userPrefixModeToSymbolTable[mode];
+	} else {
+		return 0;
+	}
+}
+
+- (NSInteger)rankForUserPrefixMode:(UniChar)mode
 {
-	id prefix = [self modeCharacterFromUserPrefixSymbol:symbol];
+	if (_characterIsInTableRange(mode)) {
+		return _userPrefixModeRankTable[mode];
+	} else {
+		return 0;
+	}
+}
 
-	return ((prefix == nil) == NO);
+- (IRCISupportChannelModeParameterType)parameterTypeForChannelMode:(UniChar)mode
+{
+	if (_characterIsInTableRange(mode)) {
+		return _channelModeParameterTypeTable[mode];
+	} else {
+		return IRCISupportChannelModeParameterUnknownType;
+	}
 }
 
-- (NSInteger)rankForUserPrefixWithMode:(NSString *)mode
+- (BOOL)characterIsChannelNamePrefix:(UniChar)character
+{
+	if (_characterIsInTableRange(character)) {
+		return _channelNamePrefixTable[character];
+	} else {
+		return NO;
+	}
+}
+
+- (void)getChannelNamePrefixTable:(BOOL *)table
 {
-#define _defaultStart			100
+	PointerIsEmptyAssert(table);
 
-	NSObjectIsEmptyAssertReturn(mode, _defaultStart);
+	@synchronized(self) {
+		memcpy(table, _channelNamePrefixTable, sizeof(_channelNamePrefixTable));
+	}
+}
 
-	__block BOOL foundResult = NO;
+- (NSString *)userModesFromPrefixSymbolsInString:(NSString *)string prefixLength:(NSUInteger *)prefixLength
+{
+	NSUInteger stringLength = [string length];
 
-	__block NSInteger rankValue = _defaultStart;
+	UniChar modes[_lookupTableSize];
 
-	[self.userModePrefixes enumerateObjectsUsingBlock:^(NSArray *obj, NSUInteger idx, BOOL *stop) {
-		if (NSObjectsAreEqual(obj[0], mode)) {
-			*stop = YES;
+	NSUInteger i = 0;
 
-			foundResult = YES;
-		} else {
-			rankValue -= 1;
+	while (i < stringLength && i < _lookupTableSize) {
+		UniChar mode = [self modeForUserPrefixSymbol:[string characterAtIndex:i]];
+
+		if (mode == 0) {
+			break;
 		}
-	}];
 
-#undef _defaultStart
+		modes[i] = mode;
+
+		i += 1;
+	}
+
+	if (prefixLength) {
+		*prefixLength = i;
+	}
+
+	if (i == 0) {
+		return nil;
+	} else {
+		return [NSString stringWithCharacters:modes length:i];
+	}
+}
+
+#pragma mark -
+#pragma mark User Prefixes
+
+- (NSString *)userModePrefixSymbolWithMode:(NSString *)mode
+{
+	if ([mode length] != 1) {
+		return nil;
+	}
+
+	UniChar symbol = [self userPrefixSymbolForMode:[mode characterAtIndex:0]];
+
+	if (symbol == 0) {
+		return nil;
+	} else {
+		return [NSString stringWithCharacters:&symbol length:1];
+	}
+}
+
+- (BOOL)modeIsSupportedUserPrefix:(NSString *)mode
+{
+	if ([mode length] != 1) {
+		return NO;
+	}
+
+	return ([self userPrefixSymbolForMode:[mode characterAtIndex:0]] > 0);
+}
+
+- (NSString *)modeCharacterFromUserPrefixSymbol:(NSString *)symbol
+{
+	if ([symbol length] != 1) {
+		return nil;
+	}
 
-	if (foundResult) {
-		return rankValue;
+	UniChar mode = [self modeForUserPrefixSymbol:[symbol characterAtIndex:0]];
+
+	if (mode == 0) {
+		return nil;
 	} else {
+		return [NSString stringWithCharacters:&mode length:1];
+	}
+}
+
+- (BOOL)symbolIsUserPrefixCharacter:(NSString *)symbol
+{
+	if ([symbol length] != 1) {
+		return NO;
+	}
+
+	return ([self modeForUserPrefixSymbol:[symbol characterAtIndex:0]] > 0);
+}
+
+- (NSInteger)rankForUserPrefixWithMode:(NSString *)mode
+{
+	NSObjectIsEmptyAssertReturn(mode, _channelUserModeValue);
+
+	if ([mode length] != 1) {
 		return 0; // Nothing was found at all for input.
 	}
+
+	return [self rankForUserPrefixMode:[mode characterAtIndex:0]];
 }
 
+#undef _characterIsInTableRange
+
 - (IRCModeInfo *)createMode:(NSString *)mode
 {
 	NSObjectIsEmptyAssertReturn(mode, nil);
@@ -38,11 +38,27 @@
 
 #import "TextualApplication.h"
 
+#import <malloc/malloc.h>
+
 #define _colorNumberMax				 30
 
 #define _presentAwayMessageFor301Threshold			300.0f
 
 @interface IRCUser ()
+{
+	/* Status flags and the ranks derived from -modes are packed together
+	 because a user exists once for every channel it shares with us. */
+	struct {
+		unsigned int isCop : 1;
+		unsigned int isAway : 1;
+		unsigned int rank : 8;		// IRCUserRank
+		unsigned int ranks : 8;		// IRCUserRank
+	} _userFlags;
+
+	NSString *_cachedHostmask;
+}
+
+@property (nonatomic, weak) IRCClient *associatedClient;
 @property (nonatomic, weak) IRCISupportInfo *supportInfo;
 @property (nonatomic, assign) CFAbsoluteTime presentAwayMessageFor301LastEvent;
 @end
@@ -53,6 +69,9 @@
 {
 	if ((self = [super init])) {
 		self.colorNumber = -1;
+
+		_userFlags.rank = IRCUserNoRank;
+		_userFlags.ranks = IRCUserNoRank;
 		
 		self.lastWeightFade = CFAbsoluteTimeGetCurrent();
 	}
@@ -73,6 +92,8 @@
 {
 	IRCUser *newUser = [IRCUser new];
 
+	[newUser setAssociatedClient:client];
+
 	[newUser setSupportInfo:[client supportInfo]];
 
 	[newUser setNickname:nickname];
@@ -80,12 +101,94 @@
 	return newUser;
 }
 
+#pragma mark -
+#pragma mark Property Storage
+
+- (NSString *)internedString:(NSString *)value
+{
+	IRCClient *client = self.associatedClient;
+
+	if (client) {
+		return [client internedUserString:value];
+	} else {
+		return [value copy];
+	}
+}
+
+- (void)setNickname:(NSString *)nickname
+{
+	if (NSObjectsAreEqual(_nickname, nickname) == NO) {
+		_nickname = [self internedString:nickname];
+
+		_cachedHostmask = nil;
+	}
+}
+
+- (void)setUsername:(NSString *)username
+{
+	if (NSObjectsAreEqual(_username, username) == NO) {
+		_username = [self internedString:username];
+
+		_cachedHostmask = nil;
+	}
+}
+
+- (void)setAddress:(NSString *)address
+{
+	if (NSObjectsAreEqual(_address, address) == NO) {
+		_address = [self internedString:address];
+
+		_cachedHostmask = nil;
+	}
+}
+
+- (void)setModes:(NSString *)modes
+{
+	_modes = [modes copy];
+
+	/* Ranks are derived once here instead of on every comparison. */
+	IRCUserRank ranks = 0;
+
+	for (NSInteger i = 0; i < [_modes length]; i++) {
+		NSString *cc = [_modes stringCharacterAtIndex:i];
+
+		IRCUserRank rank = [self rankWithMark:cc];
+
+		if (NSDissimilarObjects(rank, IRCUserNoRank)) {
+			ranks |= rank;
+		}
+	}
+
+	if (ranks == 0) {
+		ranks |= IRCUserNoRank;
+	}
+
+	_userFlags.ranks = ranks;
+
+	_userFlags.rank = [self rankWithMark:[self highestRankedUserMode]];
+}
+
+- (BOOL)isCop
+{
+	return _userFlags.isCop;
+}
+
+- (void)setIsCop:(BOOL)isCop
+{
+	_userFlags.isCop = (isCop ? 1 : 0);
+}
+
+- (BOOL)isAway
+{
+	return _userFlags.isAway;
+}
+
 - (void)setIsAway:(BOOL)isAway
 {
-	if (NSDissimilarObjects(isAway, _isAway)) {
-		_isAway = isAway;
+	if (NSDissimilarObjects(isAway, _userFlags.isAway)) {
+		_userFlags.isAway = (isAway ? 1 : 0);
 
-		if (_isAway == NO) {
+		if (isAway == NO) {
 			if (self.presentAwayMessageFor301LastEvent > 0.0) {
 				self.presentAwayMessageFor301LastEvent = 0.0f;
 			}
@@ -93,6 +196,8 @@
 	}
 }
 
+#pragma mark -
+
 - (BOOL)presentAwayMessageFor301
 {
 	if (self.isAway == NO) {
@@ -115,8 +220,13 @@
 	NSObjectIsEmptyAssertReturn(self.nickname, nil);
 	NSObjectIsEmptyAssertReturn(self.username, nil);
 	NSObjectIsEmptyAssertReturn(self.address, nil);
-	
-	return [NSString stringWithFormat:@"%@!%@@%@", self.nickname, self.username, self.address];
+
+	/* The cache is discarded by the setters of each component. */
+	if (_cachedHostmask == nil) {
+		_cachedHostmask = [NSString stringWithFormat:@"%@!%@@%@", self.nickname, self.username, self.address];
+	}
+
+	return _cachedHostmask;
 }
 
 - (NSString *)banMask
@@ -172,10 +282,8 @@
 
 - (NSInteger)channelRank
 {
-	NSString *highestRank = [self highestRankedUserMode];
-
-	if (highestRank) {
-		return [self.supportInfo rankForUserPrefixWithMode:highestRank];
+	if (NSObjectIsNotEmpty(self.modes)) {
+		return [self.supportInfo rankForUserPrefixMode:[self.modes characterAtIndex:0]];
 	} else {
 		return 0; // Furthest that can be gone down.
 	}
@@ -226,32 +334,12 @@
 
 - (IRCUserRank)rank
 {
-	NSString *highestMark = [self highestRankedUserMode];
-
-	return [self rankWithMark:highestMark];
+	return _userFlags.rank;
 }
 
 - (IRCUserRank)ranks
 {
-	IRCUserRank ranks = 0;
-
-	if (NSObjectIsEmpty(self.modes) == NO) {
-		for (NSInteger i = 0; i < [self.modes length]; i++) {
-			NSString *cc = [self.modes stringCharacterAtIndex:i];
-
-			IRCUserRank rank = [self rankWithMark:cc];
-
-			if (NSDissimilarObjects(rank, IRCUserNoRank)) {
-				ranks |= rank;
-			}
-		}
-	}
-
-	if (ranks == 0) {
-		ranks |= IRCUserNoRank;
-	}
-
-	return ranks;
+	return _userFlags.ranks;
 }
 
 - (IRCUserRank)rankWithMark:(NSString *)mark
@@ -424,6 +512,8 @@
 
 - (void)migrate:(IRCUser *)from
 {
+	self.associatedClient = [from associatedClient];
+
 	self.supportInfo = [from supportInfo];
 	
 	self.nickname = [from nickname];
@@ -440,6 +530,13 @@
 	self.isAway = [from isAway];
 }
 
+- (NSUInteger)estimatedMemoryFootprint
+{
+	/* Strings are not included because they are shared between every 
+	 instance of the same user through the interning table of the client. */
+	return malloc_size((__bridge const void *)self);
+}
+
 - (NSString *)description
 {
 	return [NSString stringWithFormat:@"<IRCUser %@%@>", self.mark, self.nickname];
@@ -52,6 +52,7 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 
 @interface IRCWorld ()
 @property (nonatomic, assign) BOOL preferencesDidChangeTimerIsActive;
+@property (nonatomic, strong) NSMutableDictionary *clientIdentifierLookupTable; // treeUUID and config UUID -> IRCClient
 @end
 
 @implementation IRCWorld
@@ -63,6 +64,8 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 {
 	if ((self = [super init])) {
 		self.clients = [NSMutableArray new];
+
+		self.clientIdentifierLookupTable = [NSMutableDictionary new];
 		
 		self.textSizeMultiplier = 1.0f;
 
@@ -86,10 +89,14 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 	
 	NSDictionary *config = [TPCPreferences loadWorld];
 
+	[TVCLogController beginRestoringHistoryOfViews];
+
 	for (NSDictionary *e in config[IRCWorldControllerClientListDefaultsStorageKey]) {
 		[self createClient:e reload:YES];
 	}
 
+	[TVCLogController endRestoringHistoryOfViews];
+
 	if ([config boolForKey:@"soundIsMuted"]) {
 		[menuController() toggleMuteOnNotificationSoundsShortcut:NSOnState];
 	}
@@ -183,6 +190,8 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 			
 			[self.clients addObjectsFromArray:clientList];
 
+			[self rebuildClientLookupTable];
+
 			[self postClientListWasModifiedNotification];
 		}
 	});
@@ -204,6 +213,26 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 #pragma mark -
 #pragma mark Utilities
 
+- (void)rebuildClientLookupTable
+{
+	@synchronized(self.clients) {
+		[self.clientIdentifierLookupTable removeAllObjects];
+
+		for (IRCClient *u in self.clients) {
+			NSString *treeUUID = [u treeUUID];
+			NSString *uniqueIdentifier = [u uniqueIdentifier];
+
+			if (treeUUID) {
+				self.clientIdentifierLookupTable[treeUUID] = u;
+			}
+
+			if (uniqueIdentifier) {
+				self.clientIdentifierLookupTable[uniqueIdentifier] = u;
+			}
+		}
+	}
+}
+
 - (void)postClientListWasModifiedNotification
 {
 	[RZNotificationCenter() postNotificationName:IRCWorldClientListWasModifiedNotification object:self];
@@ -374,6 +403,10 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 	}
 
 	[TVCImageURLoader invalidateInternalCache];
+
+	[sharedPluginManager() preferencesChanged];
+
+	TXFormattedTimestampInvalidateCache();
 }
 
 - (void)setupMidnightTimer
@@ -442,17 +475,11 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 
 - (IRCClient *)findClientById:(NSString *)uid
 {
+	NSObjectIsEmptyAssertReturn(uid, nil);
+
 	@synchronized(self.clients) {
-		for (IRCClient *u in self.clients) {
-			if ([uid isEqualToString:[u treeUUID]] ||
-				[uid isEqualToString:[u uniqueIdentifier]])
-			{
-				return u;
-			}
-		}
+		return self.clientIdentifierLookupTable[uid];
 	}
-	
-	return nil;
 }
 
 - (IRCChannel *)findChannelByClientId:(NSString *)uid channelId:(NSString *)cid
@@ -460,13 +487,7 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 	IRCClient *u = [self findClientById:uid];
 	
 	if (u) {
-		for (IRCChannel *c in u.channelList) {
-			if ([cid isEqualToString:[c treeUUID]] ||
-				[cid isEqualToString:[c uniqueIdentifier]])
-			{
-				return c;
-			}
-		}
+		return [u findChannelByIdentifier:cid];
 	}
 	
 	return nil;
@@ -522,13 +543,23 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 - (void)reloadTheme:(BOOL)reloadUserInterface
 {
 	[themeController() reload];
+
+	/* The selected view is reloaded first so that it is usable while
+	 the remaining views are rendered in the background. */
+	TVCLogController *selectedViewController = [mainWindow() selectedViewController];
+
+	[selectedViewController reloadTheme];
 	
 	@synchronized(self.clients) {
 		for (IRCClient *u in self.clients) {
-			[u.viewController reloadTheme];
+			if (u.viewController != selectedViewController) {
+				[u.viewController reloadTheme];
+			}
 
 			for (IRCChannel *c in u.channelList) {
-				[c.viewController reloadTheme];
+				if (c.viewController != selectedViewController) {
+					[c.viewController reloadTheme];
+				}
 			}
 		}
 	}
@@ -650,6 +681,8 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 
 	@synchronized(self.clients) {
 		[self.clients addObject:c];
+
+		[self rebuildClientLookupTable];
 	
 		if (reload) {
 			NSInteger index = [self.clients indexOfObject:c];
@@ -778,6 +811,8 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 		if ([target isClient]) {
 			[self.clients removeObjectIdenticalTo:target];
 
+			[self rebuildClientLookupTable];
+
 			[self postClientListWasModifiedNotification];
 		} else {
 			IRCClient *u = [target associatedClient];
@@ -832,6 +867,8 @@ NSString * const IRCWorldClientListWasModifiedNotification = @"IRCWorldClientLis
 	} else {
 		@synchronized(self.clients) {
 			[self.clients removeObjectIdenticalTo:u];
+
+			[self rebuildClientLookupTable];
 		}
 
 		[self postClientListWasModifiedNotification];
@@ -38,6 +38,12 @@
 
 #import "TextualApplication.h"
 
+#import <zlib.h>
+
+#define _transcriptCompressionBufferSize		65536
+
+#define _structuredTranscriptReadChunkSize		262144
+
 NSString * const TLOFileLoggerConsoleDirectoryName				= @"Console";
 NSString * const TLOFileLoggerChannelDirectoryName				= @"Channels";
 NSString * const TLOFileLoggerPrivateMessageDirectoryName		= @"Queries";
@@ -49,10 +55,15 @@ NSString * const TLOFileLoggerNoticeNicknameFormat		= @"-%n-";
 NSString * const TLOFileLoggerISOStandardClockFormat		= @"[%Y-%m-%dT%H:%M:%S%z]"; // 2008-07-09T16:13:30+12:00
 NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 
+NSString * const TLOFileLoggerCompressedTranscriptPathExtension		= @"gz";
+NSString * const TLOFileLoggerStructuredTranscriptPathExtension		= @"jsonl";
+
 @interface TLOFileLogger ()
 @property (readonly, copy) NSURL *fileWritePath;
 @property (nonatomic, copy) NSURL *filename;
 @property (nonatomic, strong) NSFileHandle *file;
+@property (nonatomic, strong) NSFileHandle *structuredFile;
+@property (nonatomic, copy) NSString *structuredFilePath;
 @end
 
 @implementation TLOFileLogger
@@ -65,6 +76,16 @@ NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 	NSString *lineString = [logLine renderedBodyForTranscriptLogInChannel:self.channel];
 
 	[self writePlainTextLine:lineString];
+
+	/* The plain text write above reopened the files if needed. */
+	if (self.structuredFile) {
+		NSData *jsondata = [logLine jsonDictionaryRepresentation];
+
+		if (jsondata) {
+			[self.structuredFile writeData:jsondata];
+			[self.structuredFile writeData:[NSData lineFeed]];
+		}
+	}
 }
 
 - (void)writePlainTextLine:(NSString *)s
@@ -90,6 +111,10 @@ NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 	if ( self.file) {
 		[self.file truncateFileAtOffset:0];
 	}
+
+	if ( self.structuredFile) {
+		[self.structuredFile truncateFileAtOffset:0];
+	}
 }
 
 - (void)close
@@ -99,9 +124,67 @@ NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 		 self.file = nil;
 	}
 
+	[self closeStructuredFile];
+
 	self.filename = nil;
 }
 
+- (void)closeStructuredFile
+{
+	if ( self.structuredFile) {
+		[self.structuredFile closeFile];
+		 self.structuredFile = nil;
+	}
+
+	if ( self.structuredFilePath) {
+		[TLOFileLogger structuredTranscriptAtPathWasClosed:self.structuredFilePath];
+
+		self.structuredFilePath = nil;
+	}
+}
+
+/* Paths of the structured transcripts that loggers have open for writing.
+ A path can be open more than once when two loggers share a file. */
++ (NSCountedSet *)openStructuredTranscriptPaths
+{
+	static NSCountedSet *openPaths = nil;
+
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		openPaths = [NSCountedSet new];
+	});
+
+	return openPaths;
+}
+
++ (void)structuredTranscriptAtPathWasOpened:(NSString *)path
+{
+	NSCountedSet *openPaths = [TLOFileLogger openStructuredTranscriptPaths];
+
+	@synchronized(openPaths) {
+		[openPaths addObject:[path stringByStandardizingPath]];
+	}
+}
+
++ (void)structuredTranscriptAtPathWasClosed:(NSString *)path
+{
+	NSCountedSet *openPaths = [TLOFileLogger openStructuredTranscriptPaths];
+
+	@synchronized(openPaths) {
+		[openPaths removeObject:[path stringByStandardizingPath]];
+	}
+}
+
++ (BOOL)structuredTranscriptIsOpenAtPath:(NSString *)path
+{
+	NSCountedSet *openPaths = [TLOFileLogger openStructuredTranscriptPaths];
+
+	@synchronized(openPaths) {
+		return [openPaths containsObject:[path stringByStandardizingPath]];
+	}
+}
+
 - (void)reopenIfNeeded
 {
 	/* This call is designed to reopen the file pointer when using
@@ -110,6 +193,8 @@ NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 
 	if ([[self buildFileName] isEqual:self.filename] == NO) {
 		[self open];
+	} else if ([TPCPreferences logTranscriptInStructuredFormat] != (self.structuredFile != nil)) {
+		[self open];
 	}
 }
 
@@ -168,6 +253,31 @@ NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 	if ( self.file) {
 		[self.file seekToEndOfFile];
 	}
+
+	/* Open the structured transcript which sits next to the plain text one. */
+	[self closeStructuredFile];
+
+	if ([TPCPreferences logTranscriptInStructuredFormat]) {
+		NSString *structuredPath = [[[self.filename path] stringByDeletingPathExtension] stringByAppendingPathExtension:TLOFileLoggerStructuredTranscriptPathExtension];
+
+		if ([RZFileManager() fileExistsAtPath:structuredPath] == NO) {
+			[RZFileManager() createFileAtPath:structuredPath contents:nil attributes:nil];
+		}
+
+		self.structuredFile = [NSFileHandle fileHandleForUpdatingAtPath:structuredPath];
+
+		if ( self.structuredFile) {
+			[self.structuredFile seekToEndOfFile];
+
+			self.structuredFilePath = structuredPath;
+
+			[TLOFileLogger structuredTranscriptAtPathWasOpened:structuredPath];
+		}
+	}
+
+	/* A new file is opened at launch and each time the date changes
+	 which makes this a good place to look for days to archive. */
+	[TLOFileLogger compressArchivedTranscriptsIfNeeded];
 }
 
 #pragma mark -
@@ -242,6 +352,313 @@ NSString * const TLOFileLoggerTwentyFourHourClockFormat		= @"[%H:%M:%S]";
 	return nil;
 }
 
+#pragma mark -
+#pragma mark Transcript Archiving
+
++ (void)compressArchivedTranscriptsIfNeeded
+{
+	static NSString *lastCompressionDay = nil;
+
+	static dispatch_queue_t compressionQueue = NULL;
+
+	PointerIsEmptyAssert([TPCPathInfo logFileFolderLocation]);
+
+	if ([TPCPreferences logTranscriptCompressionEnabled] == NO) {
+		return;
+	}
+
+	/* Only look for work once a day. */
+	NSString *today = TXFormattedTimestamp([NSDate date], @"%Y-%m-%d");
+
+	@synchronized(self) {
+		if ([today isEqualToString:lastCompressionDay]) {
+			return;
+		}
+
+		lastCompressionDay = today;
+
+		if (compressionQueue == NULL) {
+			compressionQueue = dispatch_queue_create("transcriptCompressionQueue", DISPATCH_QUEUE_SERIAL);
+
+			/* Work targeting the background queue has its disk access throttled. */
+			dispatch_set_target_queue(compressionQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+		}
+	}
+
+	/* Day files are named after their date which means one
+	 string comparison tells whether a file is old enough. */
+	NSTimeInterval compressionDelay = ([TPCPreferences logTranscriptCompressionDelay] * 86400);
+
+	NSString *cutoffDay = TXFormattedTimestamp([NSDate dateWithTimeIntervalSinceNow:(-compressionDelay)], @"%Y-%m-%d");
+
+	NSURL *logFolder = [TPCPathInfo logFileFolderLocation];
+
+	dispatch_async(compressionQueue, ^{
+		[TLOFileLogger compressTranscriptsInFolder:logFolder olderThanDay:cutoffDay];
+	});
+}
+
++ (void)compressTranscriptsInFolder:(NSURL *)folder olderThanDay:(NSString *)cutoffDay
+{
+	NSDirectoryEnumerator *enumerator = [RZFileManager() enumeratorAtURL:folder
+											  includingPropertiesForKeys:nil
+																 options:NSDirectoryEnumerationSkipsHiddenFiles
+															errorHandler:nil];
+
+	for (NSURL *fileURL in enumerator) {
+		if ([[fileURL pathExtension] isEqualToString:@"txt"] == NO) {
+			continue;
+		}
+
+		NSString *fileDay = [[fileURL lastPathComponent] stringByDeletingPathExtension];
+
+		if ([fileDay length] != [cutoffDay length] || [fileDay compare:cutoffDay] != NSOrderedAscending) {
+			continue;
+		}
+
+		@autoreleasepool {
+			[TLOFileLogger compressTranscriptAtPath:[fileURL path]];
+		}
+	}
+}
+
++ (BOOL)compressTranscriptAtPath:(NSString *)path
+{
+	/* The compressed copy is written under a temporary name and only
+	 replaces the original once it is complete so that an interrupted
+	 run never leaves a day half compressed. */
+	NSString *destinationPath = [path stringByAppendingPathExtension:TLOFileLoggerCompressedTranscriptPathExtension];
+
+	NSString *temporaryPath = [destinationPath stringByAppendingPathExtension:@"partial"];
+
+	/* A compressed copy of the day that already exists is never replaced. */
+	if ([RZFileManager() fileExistsAtPath:destinationPath]) {
+		LogToConsole(@"Not compressing transcript because a compressed copy already exists: %@", path);
+
+		return NO;
+	}
+
+	FILE *source = fopen([path fileSystemRepresentation], "rb");
+
+	if (source == NULL) {
+		return NO;
+	}
+
+	gzFile destination = gzopen([temporaryPath fileSystemRepresentation], "wb9");
+
+	if (destination == NULL) {
+		fclose(source);
+
+		return NO;
+	}
+
+	char buffer[_transcriptCompressionBufferSize];
+
+	BOOL compressionFailed = NO;
+
+	while (compressionFailed == NO) {
+		size_t bytesRead = fread(buffer, 1, _transcriptCompressionBufferSize, source);
+
+		if (bytesRead > 0) {
+			if (gzwrite(destination, buffer, (unsigned)bytesRead) != (int)bytesRead) {
+				compressionFailed = YES;
+			}
+		}
+
+		if (bytesRead < _transcriptCompressionBufferSize) {
+			if (ferror(source)) {
+				compressionFailed = YES;
+			}
+
+			break;
+		}
+	}
+
+	fclose(source);
+
+	if (gzclose(destination) != Z_OK) {
+		compressionFailed = YES;
+	}
+
+	if (compressionFailed) {
+		LogToConsole(@"Failed to compress transcript: %@", path);
+
+		[RZFileManager() removeItemAtPath:temporaryPath error:NULL];
+
+		return NO;
+	}
+
+	/* Keep the modification date of the day being archived. */
+	NSDictionary *sourceAttributes = [RZFileManager() attributesOfItemAtPath:path error:NULL];
+
+	if (sourceAttributes) {
+		[RZFileManager() setAttributes:@{NSFileModificationDate : [sourceAttributes fileModificationDate]} ofItemAtPath:temporaryPath error:NULL];
+	}
+
+	/* rename() replaces the destination without asking. The compressed copy
+	 may have appeared while this one was being written so check again. */
+	if ([RZFileManager() fileExistsAtPath:destinationPath] ||
+		rename([temporaryPath fileSystemRepresentation], [destinationPath fileSystemRepresentation]) != 0)
+	{
+		[RZFileManager() removeItemAtPath:temporaryPath error:NULL];
+
+		return NO;
+	}
+
+	[RZFileManager() removeItemAtPath:path error:NULL];
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Structured Transcript Reading
+
+/* Calls the block for each line in the bytes. The last line is only included
+ when it ends with a line feed or when isFinal is YES. Returns the number of
+ bytes that were handled, which stops short of a line that was not included. */
+static NSUInteger TLOFileLoggerEnumerateEntriesInBytes(const char *bytes, NSUInteger length, BOOL isFinal, void (^block)(NSData *entryData, BOOL *stop), BOOL *stop)
+{
+	const char *lineStart = bytes;
+	const char *bytesEnd = (bytes + length);
+
+	while (*stop == NO && lineStart < bytesEnd) {
+		const char *lineEnd = memchr(lineStart, '\n', (bytesEnd - lineStart));
+
+		if (lineEnd == NULL) {
+			if (isFinal == NO) {
+				break;
+			}
+
+			lineEnd = bytesEnd;
+		}
+
+		if (lineEnd > lineStart) {
+			@autoreleasepool {
+				/* The entry refers to the bytes directly and is
+				 only valid for the duration of the block. */
+				NSData *entryData = [NSData dataWithBytesNoCopy:(void *)lineStart length:(lineEnd - lineStart) freeWhenDone:NO];
+
+				block(entryData, stop);
+			}
+		}
+
+		lineStart = (lineEnd + 1);
+	}
+
+	if (lineStart > bytesEnd) {
+		lineStart = bytesEnd;
+	}
+
+	return (lineStart - bytes);
+}
+
++ (BOOL)enumerateEntriesInStructuredTranscriptAtURL:(NSURL *)url usingBlock:(void (^)(NSData *entryData, BOOL *stop))block
+{
+	PointerIsEmptyAssertReturn(url, NO);
+	PointerIsEmptyAssertReturn(block, NO);
+
+	/* A file that a logger has open can be truncated by -reset while it is
+	 being scanned. Touching a mapped page past its new end raises SIGBUS. */
+	if ([TLOFileLogger structuredTranscriptIsOpenAtPath:[url path]]) {
+		return [TLOFileLogger enumerateEntriesInOpenStructuredTranscriptAtURL:url usingBlock:block];
+	}
+
+	/* The file is mapped into memory instead of being read so that pages
+	 are brought in as they are scanned and dropped again under pressure,
+	 no matter how large the file is. */
+	NSError *readError = nil;
+
+	NSData *fileData = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:&readError];
+
+	if (fileData == nil) {
+		LogToConsole(@"Failed to read structured transcript: %@", [readError localizedDescription]);
+
+		return NO;
+	}
+
+	BOOL stop = NO;
+
+	(void)TLOFileLoggerEnumerateEntriesInBytes([fileData bytes], [fileData length], YES, block, &stop);
+
+	return YES;
+}
+
++ (BOOL)enumerateEntriesInOpenStructuredTranscriptAtURL:(NSURL *)url usingBlock:(void (^)(NSData *entryData, BOOL *stop))block
+{
+	/* Only what was written before the scan began is read and it is read a
+	 chunk at a time so that the memory used does not grow with the file.
+	 Lines written while scanning are left for the next scan. If the file is
+	 truncated while scanning, then the scan ends where the file now ends. */
+	NSError *readError = nil;
+
+	NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:url error:&readError];
+
+	if (fileHandle == nil) {
+		LogToConsole(@"Failed to read structured transcript: %@", [readError localizedDescription]);
+
+		return NO;
+	}
+
+	BOOL readSucceeded = YES;
+
+	@try {
+		unsigned long long fileLength = [fileHandle seekToEndOfFile];
+
+		[fileHandle seekToFileOffset:0];
+
+		unsigned long long fileOffset = 0;
+
+		/* Holds the start of a line that continues into the next chunk. */
+		NSMutableData *pendingData = [NSMutableData data];
+
+		BOOL stop = NO;
+
+		while (stop == NO && fileOffset < fileLength) {
+			@autoreleasepool {
+				NSUInteger chunkSize = (NSUInteger)MIN((fileLength - fileOffset), _structuredTranscriptReadChunkSize);
+
+				NSData *chunkData = [fileHandle readDataOfLength:chunkSize];
+
+				if ([chunkData length] == 0) {
+					break;
+				}
+
+				fileOffset += [chunkData length];
+
+				[pendingData appendData:chunkData];
+
+				BOOL isFinal = (fileOffset >= fileLength);
+
+				NSUInteger handledLength = TLOFileLoggerEnumerateEntriesInBytes([pendingData bytes], [pendingData length], isFinal, block, &stop);
+
+				[pendingData replaceBytesInRange:NSMakeRange(0, handledLength) withBytes:NULL length:0];
+			}
+		}
+	}
+	@catch (NSException *exception) {
+		LogToConsole(@"Failed to read structured transcript: %@", [exception reason]);
+
+		readSucceeded = NO;
+	}
+
+	[fileHandle closeFile];
+
+	return readSucceeded;
+}
+
++ (BOOL)enumerateLogLinesInStructuredTranscriptAtURL:(NSURL *)url usingBlock:(void (^)(TVCLogLine *logLine, BOOL *stop))block
+{
+	PointerIsEmptyAssertReturn(block, NO);
+
+	return [TLOFileLogger enumerateEntriesInStructuredTranscriptAtURL:url usingBlock:^(NSData *entryData, BOOL *stop) {
+		TVCLogLine *logLine = [[TVCLogLine alloc] initWithRawJSONData:entryData];
+
+		if (logLine) {
+			block(logLine, stop);
+		}
+	}];
+}
+
 #pragma mark -
 #pragma mark Memory Management
 
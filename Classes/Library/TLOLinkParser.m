@@ -38,17 +38,73 @@
 
 #import "TextualApplication.h"
 
+#import <stdatomic.h>
+
+#define _scannerThreadDictionaryKey			@"TLOLinkParserHyperlinkScanner"
+
 @implementation TLOLinkParser
 
++ (BOOL)stringMayContainLinks:(NSString *)body
+{
+	/* Every link the scanner recognizes contains either a period (domain name)
+	 or a colon (scheme or IPv6 address), which also covers "www" prefixes. Most
+	 chat lines contain neither so this saves spinning up the scanner for them. */
+	CFStringRef bodyRef = (__bridge CFStringRef)body;
+
+	CFIndex bodyLength = CFStringGetLength(bodyRef);
+
+	CFStringInlineBuffer bodyBuffer;
+
+	CFStringInitInlineBuffer(bodyRef, &bodyBuffer, CFRangeMake(0, bodyLength));
+
+	for (CFIndex i = 0; i < bodyLength; i++) {
+		UniChar c = CFStringGetCharacterFromInlineBuffer(&bodyBuffer, i);
+
+		if (c == '.' || c == ':') {
+			return YES;
+		}
+	}
+
+	return NO;
+}
+
++ (AHHyperlinkScanner *)scannerForCurrentThread
+{
+	/* The scanner keeps no state between calls to -matchesForString: so one
+	 instance is kept per thread instead of being created for each message. */
+	NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+
+	AHHyperlinkScanner *scanner = threadDictionary[_scannerThreadDictionaryKey];
+
+	if (scanner == nil) {
+		scanner = [AHHyperlinkScanner new];
+
+		threadDictionary[_scannerThreadDictionaryKey] = scanner;
+	}
+
+	return scanner;
+}
+
 + (NSArray *)locatedLinksForString:(NSString *)body
 {
-	AHHyperlinkScanner *scanner = [AHHyperlinkScanner new];
-	
-	NSArray *result = [scanner matchesForString:body];
-	
-	scanner = nil;
+	NSObjectIsEmptyAssertReturn(body, @[]);
+
+	if ([TLOLinkParser stringMayContainLinks:body] == NO) {
+		return @[];
+	}
+
+	AHHyperlinkScanner *scanner = [TLOLinkParser scannerForCurrentThread];
 	
-	return result;
+	return [scanner matchesForString:body];
+}
+
++ (NSString *)uniqueLinkIdentifier
+{
+	static _Atomic(int64_t) _linkIdentifierCounter = 0;
+
+	int64_t identifier = (atomic_fetch_add(&_linkIdentifierCounter, 1) + 1);
+
+	return [NSString stringWithFormat:@"link-%llx", identifier];
 }
 
 + (NSArray *)bannedLineTypes
@@ -260,6 +260,22 @@ NSInteger const TPCPreferencesDictionaryVersion		= 100;
 	return [RZUserDefaults() boolForKey:@"AutomaticallyFilterUnicodeTextSpam"];
 }
 
++ (NSUInteger)automaticallyFilterUnicodeTextSpamMaximumCombiningCharacters
+{
+	NSInteger maximumCharacters = [RZUserDefaults() integerForKey:@"AutomaticallyFilterUnicodeTextSpam -> Maximum Consecutive Combining Characters"];
+
+	if (maximumCharacters < 0) {
+		return 0;
+	} else {
+		return maximumCharacters;
+	}
+}
+
++ (BOOL)deferRenderingInHiddenViews
+{
+	return [RZUserDefaults() boolForKey:@"DeferRenderingInHiddenViews"];
+}
+
 + (BOOL)nickAllConnections
 {
 	return [RZUserDefaults() boolForKey:@"ApplyCommandToAllConnections -> nick"];
@@ -320,6 +336,38 @@ NSInteger const TPCPreferencesDictionaryVersion		= 100;
 	return ([RZUserDefaults() boolForKey:@"LogTranscript"] && [TPCPathInfo logFileFolderLocation]);
 }
 
++ (BOOL)logTranscriptCompressionEnabled
+{
+	return [RZUserDefaults() boolForKey:@"LogTranscriptCompressArchivedFiles"];
+}
+
++ (NSUInteger)logTranscriptCompressionDelay
+{
+	NSInteger delay = [RZUserDefaults() integerForKey:@"LogTranscriptCompressArchivedFilesAfterDays"];
+
+	/* The file for the current day is never compressed. */
+	if (delay < 1) {
+		return 1;
+	}
+
+	return delay;
+}
+
++ (BOOL)logTranscriptInStructuredFormat
+{
+	return [RZUserDefaults() boolForKey:@"LogTranscriptWriteStructuredFormat"];
+}
+
++ (NSUInteger)pluginWatchdogLatencyBudget
+{
+	return [RZUserDefaults() integerForKey:@"Plugin Watchdog -> Synchronous Callback Budget"];
+}
+
++ (BOOL)pluginWatchdogDisablesSlowPlugins
+{
+	return [RZUserDefaults() boolForKey:@"Plugin Watchdog -> Disable Slow Plugins"];
+}
+
 + (BOOL)openBrowserInBackground
 {
 	return [RZUserDefaults() boolForKey:@"OpenClickedLinksInBackgroundBrowser"];
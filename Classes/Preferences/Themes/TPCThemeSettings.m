@@ -42,9 +42,43 @@
 #define _templateEngineVersionMaximum			3
 #define _templateEngineVersionMinimum			3
 
+/* The function GRMustache escapes HTML with. It is used by compiled templates
+ so that a value is escaped the same way regardless of which path rendered it. */
+TEXTUAL_EXTERN NSString *GRMustacheTranslateHTMLCharacters(NSString *string);
+
+typedef NS_ENUM(NSUInteger, TPCThemeCompiledTemplateSegmentType) {
+	TPCThemeCompiledTemplateLiteralSegmentType = 0,
+	TPCThemeCompiledTemplateEscapedValueSegmentType,
+	TPCThemeCompiledTemplateUnescapedValueSegmentType,
+	TPCThemeCompiledTemplateSectionSegmentType,
+	TPCThemeCompiledTemplateInvertedSectionSegmentType,
+};
+
+/* A compiled template is a template that only uses plain variables, comments,
+ partials, and sections that are toggled by a boolean. These cover the default
+ templates and are rendered without the overhead of GRMustache. Templates that
+ use anything else are not compiled and continue to be rendered by GRMustache. */
+@interface TPCThemeCompiledTemplateSegment : NSObject
+@property (nonatomic, assign) TPCThemeCompiledTemplateSegmentType segmentType;
+@property (nonatomic, copy) NSString *segmentValue; // Literal text or the name of a key
+@property (nonatomic, strong) NSMutableArray *childSegments; // Sections only
+@end
+
+@interface TPCThemeCompiledTemplate : NSObject
+@property (nonatomic, copy) NSArray *segments;
+@property (nonatomic, assign) NSUInteger literalLength;
+
++ (TPCThemeCompiledTemplate *)compiledTemplateWithContentsOfFile:(NSString *)path;
+
+- (NSString *)renderObject:(NSDictionary *)attributes; // nil if a value cannot be handled
+@end
+
 @interface TPCThemeSettings ()
 @property (nonatomic, strong) GRMustacheTemplateRepository *styleTemplateRepository;
 @property (nonatomic, strong) GRMustacheTemplateRepository *appTemplateRepository;
+@property (nonatomic, copy) NSString *styleTemplateRepositoryPath;
+@property (nonatomic, copy) NSString *appTemplateRepositoryPath;
+@property (nonatomic, strong) NSMutableDictionary *compiledTemplates;
 @end
 
 @implementation TPCThemeSettings
@@ -142,6 +176,68 @@
 	return localTemplate;
 }
 
+- (NSString *)templatePathWithName:(NSString *)name
+{
+	/* Mirrors the lookup performed by -templateWithName: so that the compiled
+	 template and the GRMustache template always come from the same file. */
+	NSString *filename = [name stringByAppendingPathExtension:@"mustache"];
+
+	NSMutableArray *repositoryPaths = [NSMutableArray arrayWithCapacity:2];
+
+	if (self.styleTemplateRepositoryPath) {
+		[repositoryPaths addObject:self.styleTemplateRepositoryPath];
+	}
+
+	if (self.appTemplateRepositoryPath) {
+		[repositoryPaths addObject:self.appTemplateRepositoryPath];
+	}
+
+	for (NSString *repositoryPath in repositoryPaths) {
+		NSString *templatePath = [repositoryPath stringByAppendingPathComponent:filename];
+
+		if ([RZFileManager() fileExistsAtPath:templatePath]) {
+			return templatePath;
+		}
+	}
+
+	return nil;
+}
+
+- (NSString *)renderCompiledTemplateWithName:(NSString *)name attributes:(NSDictionary *)attributes
+{
+	NSObjectIsEmptyAssertReturn(name, nil);
+
+	PointerIsEmptyAssertReturn(self.compiledTemplates, nil);
+
+	id compiledTemplate = nil;
+
+	@synchronized(self.compiledTemplates) {
+		compiledTemplate = self.compiledTemplates[name];
+
+		if (compiledTemplate == nil) {
+			/* Templates are compiled once per theme. Those that cannot be compiled
+			 are remembered as such so that they are not looked at again. */
+			NSString *templatePath = [self templatePathWithName:name];
+
+			if (templatePath) {
+				compiledTemplate = [TPCThemeCompiledTemplate compiledTemplateWithContentsOfFile:templatePath];
+			}
+
+			if (compiledTemplate == nil) {
+				compiledTemplate = [NSNull null];
+			}
+
+			self.compiledTemplates[name] = compiledTemplate;
+		}
+	}
+
+	if (compiledTemplate == [NSNull null]) {
+		return nil;
+	}
+
+	return [compiledTemplate renderObject:attributes];
+}
+
 #pragma mark -
 #pragma mark Style Settings
 
@@ -225,6 +321,8 @@
 
 	self.appTemplateRepository = [GRMustacheTemplateRepository templateRepositoryWithBaseURL:[NSURL fileURLWithPath:dictPath]];
 
+	self.appTemplateRepositoryPath = dictPath;
+
 	if (self.appTemplateRepository == nil) {
 		/* Throw exception if we could not load repository. */
 
@@ -239,6 +337,8 @@
 
 	self.styleTemplateRepository = [GRMustacheTemplateRepository templateRepositoryWithBaseURL:[NSURL fileURLWithPath:dictPath]];
 
+	self.styleTemplateRepositoryPath = dictPath;
+
 	/* Reset old properties. */
 	self.channelViewFont = nil;
 
@@ -319,6 +419,15 @@
 	/* Fall back to the default repository. */
 	[self loadApplicationStyleRespository:templateEngineVersion];
 
+	/* Compiled templates belong to the theme being replaced. */
+	if (self.compiledTemplates == nil) {
+		self.compiledTemplates = [NSMutableDictionary dictionary];
+	} else {
+		@synchronized(self.compiledTemplates) {
+			[self.compiledTemplates removeAllObjects];
+		}
+	}
+
 	/* Inform our defaults controller about a few overrides. */
 	/* These setValue calls basically tell the NSUserDefaultsController for the "Preferences" 
 	 window that the active theme has overrode a few user configurable options. The window then 
@@ -331,3 +440,460 @@
 }
 
 @end
+
+#pragma mark -
+#pragma mark Compiled Templates
+
+@implementation TPCThemeCompiledTemplateSegment
+@end
+
+@implementation TPCThemeCompiledTemplate
+
++ (NSString *)stringByRemovingNewlines:(NSString *)string
+{
+	if ([string rangeOfCharacterFromSet:[NSCharacterSet newlineCharacterSet]].location == NSNotFound) {
+		return string;
+	} else {
+		return [string removeAllNewlines];
+	}
+}
+
++ (NSSet *)rendererAttributeKeys
+{
+	/* Keys that Textual supplies when rendering a template. A tag naming
+	 anything else may be resolved by GRMustache itself, for example by its
+	 standard library (localize, uppercase, isBlank, …), so a template that
+	 uses such a tag is not compiled and is left to GRMustache to render. */
+	static NSSet *rendererAttributeKeys = nil;
+
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		rendererAttributeKeys = [NSSet setWithObjects:
+			@"activeStyleAbsolutePath",
+			@"anchorInlineImageAvailable",
+			@"anchorInlineImageUniqueID",
+			@"anchorLink",
+			@"anchorLocation",
+			@"anchorTitle",
+			@"applicationResourcePath",
+			@"cacheToken",
+			@"channelName",
+			@"configuredServerName",
+			@"encryptedMessageLockTemplate",
+			@"formattedMessage",
+			@"formattedNickname",
+			@"formattedTimestamp",
+			@"formattedTopicValue",
+			@"fragmentBackgroundColor",
+			@"fragmentBackgroundColorIsSet",
+			@"fragmentContainsFormattingSymbols",
+			@"fragmentIsBold",
+			@"fragmentIsItalicized",
+			@"fragmentIsStruckthrough",
+			@"fragmentIsUnderlined",
+			@"fragmentTextColor",
+			@"fragmentTextColorIsSet",
+			@"highlightAttributeRepresentation",
+			@"imageURL",
+			@"inlineMediaArray",
+			@"inlineMediaAvailable",
+			@"inlineNicknameColorNumber",
+			@"inlineNicknameMatchFound",
+			@"inlineNicknameUserModeSymbol",
+			@"isChannelView",
+			@"isEncrypted",
+			@"isNicknameAvailable",
+			@"isPrivateMessageView",
+			@"isRemoteMessage",
+			@"lineClassAttributeRepresentation",
+			@"lineNumber",
+			@"lineRenderTime",
+			@"lineType",
+			@"messageFragment",
+			@"nickname",
+			@"nicknameColorHashingEnabled",
+			@"nicknameColorNumber",
+			@"nicknameIndentationAvailable",
+			@"nicknameType",
+			@"operatingSystemVersion",
+			@"predefinedTimestampWidth",
+			@"preferredMaximumWidth",
+			@"rawCommand",
+			@"sidebarInversionIsEnabled",
+			@"textDirectionToken",
+			@"timestamp",
+			@"userConfiguredFontName",
+			@"userConfiguredFontSize",
+			@"userConfiguredTextEncoding",
+			@"viewTypeToken",
+			nil];
+	});
+
+	return rendererAttributeKeys;
+}
+
++ (BOOL)tagNameIsSimple:(NSString *)tagName
+{
+	/* Dotted names, filters, and the implicit iterator depend on the
+	 context stack of GRMustache. Those are left to it to handle. */
+	NSObjectIsEmptyAssertReturn(tagName, NO);
+
+	return [[self rendererAttributeKeys] containsObject:tagName];
+}
+
++ (TPCThemeCompiledTemplate *)compiledTemplateWithContentsOfFile:(NSString *)path
+{
+	NSMutableArray *segments = [NSMutableArray array];
+
+	NSUInteger literalLength = 0;
+
+	NSMutableSet *includedPartials = [NSMutableSet set];
+
+	if ([self compileContentsOfFile:path intoSegments:segments literalLength:&literalLength includedPartials:includedPartials] == NO) {
+		return nil;
+	}
+
+	TPCThemeCompiledTemplate *compiledTemplate = [TPCThemeCompiledTemplate new];
+
+	[compiledTemplate setSegments:segments];
+	[compiledTemplate setLiteralLength:literalLength];
+
+	return compiledTemplate;
+}
+
++ (BOOL)compileContentsOfFile:(NSString *)path intoSegments:(NSMutableArray *)rootSegments literalLength:(NSUInteger *)literalLength includedPartials:(NSMutableSet *)includedPartials
+{
+	/* A partial that includes itself would recurse forever. */
+	if ([includedPartials containsObject:path]) {
+		return NO;
+	}
+
+	NSString *source = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:NULL];
+
+	PointerIsEmptyAssertReturn(source, NO);
+
+	[includedPartials addObject:path];
+
+	NSMutableArray *sectionStack = [NSMutableArray array];
+
+	NSMutableArray *segments = rootSegments;
+
+	NSMutableString *pendingLiteral = [NSMutableString string];
+
+	NSUInteger sourceLength = [source length];
+
+	NSUInteger position = 0;
+
+	BOOL compileFailed = NO;
+
+	while (position < sourceLength) {
+		NSRange openRange = [source rangeOfString:@"{{" options:NSLiteralSearch range:NSMakeRange(position, (sourceLength - position))];
+
+		if (openRange.location == NSNotFound) {
+			[pendingLiteral appendString:[source substringFromIndex:position]];
+
+			break;
+		}
+
+		[pendingLiteral appendString:[source substringWithRange:NSMakeRange(position, (openRange.location - position))]];
+
+		/* Determine tag type and where it ends. */
+		NSUInteger tagContentStart = NSMaxRange(openRange);
+
+		NSString *closingDelimiter = @"}}";
+
+		UniChar tagType = 0;
+
+		if (tagContentStart < sourceLength) {
+			tagType = [source characterAtIndex:tagContentStart];
+		}
+
+		if (tagType == '{') {
+			closingDelimiter = @"}}}";
+
+			tagContentStart += 1;
+		} else if (tagType == '#' || tagType == '^' || tagType == '/' || tagType == '!' || tagType == '>' || tagType == '&') {
+			tagContentStart += 1;
+		} else if (tagType == '=' || tagType == '$' || tagType == '<' || tagType == '%') {
+			/* Delimiter changes, template inheritance, and pragmas. */
+			compileFailed = YES;
+
+			break;
+		} else {
+			tagType = 0;
+		}
+
+		NSRange closeRange = [source rangeOfString:closingDelimiter options:NSLiteralSearch range:NSMakeRange(tagContentStart, (sourceLength - tagContentStart))];
+
+		if (closeRange.location == NSNotFound) {
+			compileFailed = YES;
+
+			break;
+		}
+
+		NSString *tagName = [source substringWithRange:NSMakeRange(tagContentStart, (closeRange.location - tagContentStart))];
+
+		tagName = [tagName trim];
+
+		position = NSMaxRange(closeRange);
+
+		/* Tags other than variables that are alone on their line take the
+		 whole line with them, which is what GRMustache does too. */
+		if (tagType == '#' || tagType == '^' || tagType == '/' || tagType == '!' || tagType == '>') {
+			NSUInteger lineStart = openRange.location;
+
+			while (lineStart > 0) {
+				UniChar c = [source characterAtIndex:(lineStart - 1)];
+
+				if (c == ' ' || c == '\t') {
+					lineStart -= 1;
+				} else {
+					break;
+				}
+			}
+
+			BOOL precededByLineStart = (lineStart == 0 || [source characterAtIndex:(lineStart - 1)] == '\n');
+
+			/* The indentation is at the end of the pending literal unless an
+			 earlier tag already consumed part of it. */
+			NSUInteger indentationLength = (openRange.location - lineStart);
+
+			if (indentationLength > [pendingLiteral length]) {
+				precededByLineStart = NO;
+			}
+
+			if (precededByLineStart) {
+				NSUInteger lineEnd = position;
+
+				while (lineEnd < sourceLength) {
+					UniChar c = [source characterAtIndex:lineEnd];
+
+					if (c == ' ' || c == '\t' || c == '\r') {
+						lineEnd += 1;
+					} else {
+						break;
+					}
+				}
+
+				if (lineEnd == sourceLength || [source characterAtIndex:lineEnd] == '\n') {
+					[pendingLiteral deleteCharactersInRange:NSMakeRange(([pendingLiteral length] - indentationLength), indentationLength)];
+
+					position = MIN((lineEnd + 1), sourceLength);
+				}
+			}
+		}
+
+		if (tagType == '!') {
+			continue;
+		}
+
+		/* Flush literal text collected up to this tag. */
+		if ([pendingLiteral length] > 0) {
+			NSString *literal = [self stringByRemovingNewlines:pendingLiteral];
+
+			if ([literal length] > 0) {
+				TPCThemeCompiledTemplateSegment *segment = [TPCThemeCompiledTemplateSegment new];
+
+				[segment setSegmentType:TPCThemeCompiledTemplateLiteralSegmentType];
+				[segment setSegmentValue:literal];
+
+				[segments addObject:segment];
+
+				*literalLength += [literal length];
+			}
+
+			[pendingLiteral setString:NSStringEmptyPlaceholder];
+		}
+
+		if (tagType == '>') {
+			NSString *partialPath = nil;
+
+			if ([tagName hasPrefix:@"/"]) {
+				compileFailed = YES;
+
+				break;
+			} else {
+				partialPath = [[path stringByDeletingLastPathComponent] stringByAppendingPathComponent:tagName];
+
+				partialPath = [[partialPath stringByStandardizingPath] stringByAppendingPathExtension:@"mustache"];
+			}
+
+			if ([self compileContentsOfFile:partialPath intoSegments:segments literalLength:literalLength includedPartials:includedPartials] == NO) {
+				compileFailed = YES;
+
+				break;
+			}
+
+			continue;
+		}
+
+		if ([self tagNameIsSimple:tagName] == NO) {
+			compileFailed = YES;
+
+			break;
+		}
+
+		if (tagType == '/') {
+			TPCThemeCompiledTemplateSegment *openSection = [sectionStack lastObject];
+
+			if (openSection == nil || NSObjectsAreEqual([openSection segmentValue], tagName) == NO) {
+				compileFailed = YES;
+
+				break;
+			}
+
+			[sectionStack removeLastObject];
+
+			if ([sectionStack count] > 0) {
+				segments = [[sectionStack lastObject] childSegments];
+			} else {
+				segments = rootSegments;
+			}
+
+			continue;
+		}
+
+		TPCThemeCompiledTemplateSegment *segment = [TPCThemeCompiledTemplateSegment new];
+
+		[segment setSegmentValue:tagName];
+
+		if (tagType == '#' || tagType == '^') {
+			if (tagType == '#') {
+				[segment setSegmentType:TPCThemeCompiledTemplateSectionSegmentType];
+			} else {
+				[segment setSegmentType:TPCThemeCompiledTemplateInvertedSectionSegmentType];
+			}
+
+			[segment setChildSegments:[NSMutableArray array]];
+
+			[segments addObject:segment];
+
+			[sectionStack addObject:segment];
+
+			segments = [segment childSegments];
+		} else {
+			if (tagType == '{' || tagType == '&') {
+				[segment setSegmentType:TPCThemeCompiledTemplateUnescapedValueSegmentType];
+			} else {
+				[segment setSegmentType:TPCThemeCompiledTemplateEscapedValueSegmentType];
+			}
+
+			[segments addObject:segment];
+		}
+	}
+
+	if (compileFailed == NO && [sectionStack count] > 0) {
+		compileFailed = YES; // Section left open.
+	}
+
+	if (compileFailed == NO && [pendingLiteral length] > 0) {
+		NSString *literal = [self stringByRemovingNewlines:pendingLiteral];
+
+		if ([literal length] > 0) {
+			TPCThemeCompiledTemplateSegment *segment = [TPCThemeCompiledTemplateSegment new];
+
+			[segment setSegmentType:TPCThemeCompiledTemplateLiteralSegmentType];
+			[segment setSegmentValue:literal];
+
+			[segments addObject:segment];
+
+			*literalLength += [literal length];
+		}
+	}
+
+	[includedPartials removeObject:path];
+
+	return (compileFailed == NO);
+}
+
+- (BOOL)appendSegments:(NSArray *)segments withAttributes:(NSDictionary *)attributes toString:(NSMutableString *)result
+{
+	for (TPCThemeCompiledTemplateSegment *segment in segments) {
+		TPCThemeCompiledTemplateSegmentType segmentType = [segment segmentType];
+
+		if (segmentType == TPCThemeCompiledTemplateLiteralSegmentType) {
+			[result appendString:[segment segmentValue]];
+
+			continue;
+		}
+
+		id value = attributes[[segment segmentValue]];
+
+		if (value == [NSNull null]) {
+			value = nil;
+		}
+
+		if (segmentType == TPCThemeCompiledTemplateSectionSegmentType ||
+			segmentType == TPCThemeCompiledTemplateInvertedSectionSegmentType)
+		{
+			/* Only values that toggle a section can be handled here. Anything
+			 else pushes a new context and is left to GRMustache. */
+			BOOL valueIsTrue = NO;
+
+			if (value == nil) {
+				valueIsTrue = NO;
+			} else if ([value isKindOfClass:[NSNumber class]]) {
+				valueIsTrue = [value boolValue];
+			} else if ([value isKindOfClass:[NSString class]] && [value length] == 0) {
+				valueIsTrue = NO;
+			} else {
+				return NO;
+			}
+
+			if (segmentType == TPCThemeCompiledTemplateInvertedSectionSegmentType) {
+				valueIsTrue = (valueIsTrue == NO);
+			}
+
+			if (valueIsTrue) {
+				if ([self appendSegments:[segment childSegments] withAttributes:attributes toString:result] == NO) {
+					return NO;
+				}
+			}
+
+			continue;
+		}
+
+		NSString *stringValue = nil;
+
+		if (value == nil) {
+			continue;
+		} else if ([value isKindOfClass:[NSString class]]) {
+			stringValue = value;
+		} else if ([value isKindOfClass:[NSNumber class]]) {
+			stringValue = [value description];
+		} else {
+			return NO;
+		}
+
+		stringValue = [TPCThemeCompiledTemplate stringByRemovingNewlines:stringValue];
+
+		if (segmentType == TPCThemeCompiledTemplateEscapedValueSegmentType) {
+			stringValue = GRMustacheTranslateHTMLCharacters(stringValue);
+		}
+
+		if (stringValue) {
+			[result appendString:stringValue];
+		}
+	}
+
+	return YES;
+}
+
+- (NSString *)renderObject:(NSDictionary *)attributes
+{
+	if (attributes && [attributes isKindOfClass:[NSDictionary class]] == NO) {
+		return nil;
+	}
+
+	/* Reserve room for the literal text and some room for values. */
+	NSMutableString *result = [NSMutableString stringWithCapacity:(self.literalLength * 2)];
+
+	if ([self appendSegments:self.segments withAttributes:attributes toString:result] == NO) {
+		return nil;
+	}
+
+	return [result copy];
+}
+
+@end
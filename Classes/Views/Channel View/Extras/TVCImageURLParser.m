@@ -37,6 +37,29 @@
 
 #import "TextualApplication.h"
 
+#define _imageURLParserMaxCacheSize			500
+
+/* A host rule is handed the original URL, the parsed URL, the lowercased
+ host, and the path with the query appended. It returns the URL of the image
+ to present or nil if the link is not recognized. */
+typedef NSString *(^TVCImageURLParserHostRule)(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension);
+
+/* What to do with a link to a file that has an image extension. */
+typedef NS_ENUM(NSUInteger, TVCImageURLParserExtensionPolicy) {
+	TVCImageURLParserExtensionPolicyPresent = 0,	/* Present the link as is. */
+	TVCImageURLParserExtensionPolicyIgnore,			/* The host serves pages, not images. */
+	TVCImageURLParserExtensionPolicyContinue,		/* Let the host rule decide. */
+};
+
+static NSCache *_resultCache = nil;
+
+static NSSet *_imageFileExtensions = nil;
+
+static NSDictionary *_extensionPolicies = nil;
+
+static NSDictionary *_exactHostRules = nil;
+static NSDictionary *_domainHostRules = nil;
+
 @implementation TVCImageURLParser
 
 + (NSArray *)validImageContentTypes
@@ -49,73 +72,60 @@
 	return [baseURL URLUsingWebKitPasteboard];
 }
 
-+ (NSString *)imageURLFromBase:(NSString *)url
-{
-	/* Convert URL. */
-	NSURL *u = [url URLUsingWebKitPasteboard];
 
-	NSString *plguinResult = [sharedPluginManager() processInlineMediaContentURL:[u absoluteString]];
+#pragma mark -
+#pragma mark Rule Table
 
-	if (plguinResult) {
-		return plguinResult;
-	}
-
-	NSString *scheme = [u scheme];
-
-	if ([scheme isEqualToString:@"file"]) {
-		// If the file is a local file (file:// scheme), then let us ignore it.
-		// Only the local user can see their own files.
-
-		return nil;
-	}
-	
-	NSString *host = [[u host] lowercaseString];
+/* The tables are built the first time a link is parsed instead of at launch. */
++ (void)populateRuleTableIfNeeded
+{
+	static dispatch_once_t onceToken;
 
-	NSString *path = [[u path] encodeURIFragment];
+	dispatch_once(&onceToken, ^{
+		_resultCache = [NSCache new];
 
-	NSString *query = [[u query] encodeURIFragment];
+		[_resultCache setCountLimit:_imageURLParserMaxCacheSize];
 
-	BOOL hadExtension = NO;
+		[self populateRuleTable];
+	});
+}
 
-	if ([path hasSuffixIgnoringCase:@".jpg"]	|| [query hasSuffixIgnoringCase:@".jpg"]	||
-		[path hasSuffixIgnoringCase:@".jpeg"]	|| [query hasSuffixIgnoringCase:@".jpeg"]	||
-		[path hasSuffixIgnoringCase:@".png"]	|| [query hasSuffixIgnoringCase:@".png"]	||
-		[path hasSuffixIgnoringCase:@".gif"]	|| [query hasSuffixIgnoringCase:@".gif"]	||
-		[path hasSuffixIgnoringCase:@".tif"]	|| [query hasSuffixIgnoringCase:@".tif"]	||
-		[path hasSuffixIgnoringCase:@".tiff"]	|| [query hasSuffixIgnoringCase:@".tiff"]	||
-		[path hasSuffixIgnoringCase:@".svg"]	|| [query hasSuffixIgnoringCase:@".svg"]	||
-		[path hasSuffixIgnoringCase:@".bmp"]	|| [query hasSuffixIgnoringCase:@".bmp"])
-	{
-		hadExtension = YES;
++ (void)populateRuleTable
+{
+	_imageFileExtensions = [NSSet setWithObjects:@"jpg", @"jpeg", @"png", @"gif", @"tif", @"tiff", @"svg", @"bmp", nil];
 
-        if ([host hasSuffix:@"wikipedia.org"]) {
-            return nil;
-        } else if ([url hasPrefix:@"http://fukung.net/v/"]) {
-			return [url stringByReplacingOccurrencesOfString:@"http://fukung.net/v/" withString:@"http://media.fukung.net/images/"];
-        } else if ([host hasSuffix:@"dropbox.com"]) {
-			// Continue to processing...
-		} else {
-			return [u absoluteString];
-		}
-	}
+	/* Keys of the following tables are matched against the host and then
+	 against each of its parent domains so "www.dropbox.com" finds the rule
+	 for "dropbox.com" with at most one lookup per label. */
+	_extensionPolicies = @{
+		@"wikipedia.org"	: @(TVCImageURLParserExtensionPolicyIgnore),
+		@"dropbox.com"		: @(TVCImageURLParserExtensionPolicyContinue),
+	};
 
-	if (query) {
-		path = [[path stringByAppendingString:@"?"] stringByAppendingString:query];
-	}
+	NSMutableDictionary *exactHostRules = [NSMutableDictionary dictionary];
+	NSMutableDictionary *domainHostRules = [NSMutableDictionary dictionary];
 
-	if ([host hasSuffix:@"dropbox.com"]) {
+	domainHostRules[@"dropbox.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		if ([path hasPrefix:@"/s/"] && hadExtension) {
 			return [@"https://dl.dropboxusercontent.com" stringByAppendingString:path];
 		}
-	} else if ([host hasSuffix:@"instacod.es"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"instacod.es"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
-		
+
 		NSString *s = [path substringFromIndex:1];
 
 		if ([s isNumericOnly]) {
 			return [@"http://instacod.es/file/" stringByAppendingString:s];
 		}
-	} else if ([host isEqualToString:@"pbs.twimg.com"]) {
+
+		return nil;
+	};
+
+	exactHostRules[@"pbs.twimg.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		path = [path stringByReplacingOccurrencesOfString:@"\\:(large|medium|orig|small|thumb)$"
@@ -124,7 +134,9 @@
 													range:[path range]];
 
 		return [NSString stringWithFormat:@"https://pbs.twimg.com/%@:orig", path];
-	} else if ([host isEqualToString:@"docs.google.com"]) {
+	};
+
+	exactHostRules[@"docs.google.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		if ([path hasPrefix:@"/file/d/"]) {
 			NSArray *parts = [path componentsSeparatedByString:@"/"];
 
@@ -144,9 +156,13 @@
 				return [@"https://docs.google.com/uc?id=" stringByAppendingString:photoID];
 			}
 		}
-	} else if ([host hasSuffix:@"twitpic.com"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"twitpic.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
-		
+
 		NSString *s = [path substringFromIndex:1];
 
 		if ([s length] > 5) {
@@ -158,30 +174,42 @@
 		if ([s isAlphabeticNumericOnly]) {
 			return [NSString stringWithFormat:@"http://twitpic.com/show/large/%@", s];
 		}
-	} else if ([host hasSuffix:@"cl.ly"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"cl.ly"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		NSString *p = [path substringFromIndex:1];
-        
-        NSArray *components = [p componentsSeparatedByString:@"/"];
+
+		NSArray *components = [p componentsSeparatedByString:@"/"];
 
 		NSAssertReturnR(([components count] == 2), nil);
 
 		NSString *p1 = components[0];
 		NSString *p2 = components[1];
 
-        if ([p1 isEqualIgnoringCase:@"image"]) {
-            return [NSString stringWithFormat:@"http://cl.ly/%@/content", p2];
-        }
-	} else if ([host hasSuffix:@"tweetphoto.com"]) {
+		if ([p1 isEqualIgnoringCase:@"image"]) {
+			return [NSString stringWithFormat:@"http://cl.ly/%@/content", p2];
+		}
+
+		return nil;
+	};
+
+	domainHostRules[@"tweetphoto.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		return [NSString stringWithFormat:@"http://TweetPhotoAPI.com/api/TPAPI.svc/imagefromurl?size=medium&url=%@", [url encodeURIComponent]];
-	} else if ([host hasSuffix:@"yfrog.com"]) {
+	};
+
+	domainHostRules[@"yfrog.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		return [NSString stringWithFormat:@"%@:iphone", url];
-	} else if ([host hasSuffix:@"twitgoo.com"]) {
+	};
+
+	domainHostRules[@"twitgoo.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		NSString *s = [path substringFromIndex:1];
@@ -189,7 +217,11 @@
 		if ([s isAlphabeticNumericOnly]) {
 			return [NSString stringWithFormat:@"http://twitgoo.com/show/Img/%@", s];
 		}
-	} else if ([host isEqualToString:@"img.ly"]) {
+
+		return nil;
+	};
+
+	exactHostRules[@"img.ly"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		NSString *s = [path substringFromIndex:1];
@@ -197,21 +229,29 @@
 		if ([s isAlphabeticNumericOnly]) {
 			return [NSString stringWithFormat:@"http://img.ly/show/large/%@", s];
 		}
-	} else if ([host hasSuffix:@"leetfil.es"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"leetfil.es"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		if ([path hasPrefix:@"/image/"]) {
 			NSString *s = [path substringFromIndex:7];
-            
-            if ([s isAlphabeticNumericOnly]) {
+
+			if ([s isAlphabeticNumericOnly]) {
 				return [NSString stringWithFormat:@"https://i.leetfil.es/%@", s];
 			}
 		} else if ([path hasPrefix:@"/video/"]) {
 			NSString *vid = [path substringFromIndex:7];
-            
+
 			if ([vid isAlphabeticNumericOnly]) {
 				return [NSString stringWithFormat:@"https://leetfil.es/vid/%@_thumb.png", vid];
 			}
 		}
-	} else if ([host hasSuffix:@"movapic.com"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"movapic.com"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		if ([path hasPrefix:@"/pic/"]) {
 			NSString *s = [path substringFromIndex:5];
 
@@ -219,7 +259,11 @@
 				return [NSString stringWithFormat:@"http://image.movapic.com/pic/m_%@.jpeg", s];
 			}
 		}
-	} else if ([host hasSuffix:@"f.hatena.ne.jp"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"f.hatena.ne.jp"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSArray *ary = [path componentsSeparatedByCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"/"]];
 
 		if ([ary count] >= 3) {
@@ -233,7 +277,11 @@
 				return [NSString stringWithFormat:@"http://img.f.hatena.ne.jp/images/fotolife/%@/%@/%@/%@.jpg", userIdHead, userId, photoIdHead, photoId];
 			}
 		}
-	} else if ([host isEqualToString:@"puu.sh"]) {
+
+		return nil;
+	};
+
+	exactHostRules[@"puu.sh"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSObjectIsEmptyAssertReturn(path, nil);
 
 		NSString *s = [path substringFromIndex:1];
@@ -241,7 +289,11 @@
 		if ([s isAlphabeticNumericOnly]) {
 			return [NSString stringWithFormat:@"http://puu.sh/%@.jpg", s];
 		}
-	} else if ([host hasSuffix:@"d.pr"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"d.pr"] = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		if ([path hasPrefix:@"/i/"]) {
 			NSString *s = [path substringFromIndex:3];
 
@@ -249,14 +301,18 @@
 				return [NSString stringWithFormat:@"http://d.pr/i/%@.png", s];
 			}
 		}
-	} else if ([host hasSuffix:@"youtube.com"] || [host isEqualToString:@"youtu.be"]) {
+
+		return nil;
+	};
+
+	TVCImageURLParserHostRule youtubeRule = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSString *vid = nil;
 
 		if ([host isEqualToString:@"youtu.be"]) {
 			NSString *dpath = [u path];
-			
+
 			NSObjectIsEmptyAssertReturn(dpath, nil);
-			
+
 			vid = [dpath substringFromIndex:1];
 		} else {
 			NSString *dquery = [u query];
@@ -292,14 +348,21 @@
 
 			return [NSString stringWithFormat:@"http://i.ytimg.com/vi/%@/mqdefault.jpg", vid];
 		}
-	} else if ([host hasSuffix:@"nicovideo.jp"] || [host isEqualToString:@"nico.ms"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"youtube.com"] = youtubeRule;
+	exactHostRules[@"youtu.be"] = youtubeRule;
+
+	TVCImageURLParserHostRule nicovideoRule = ^NSString *(NSString *url, NSURL *u, NSString *host, NSString *path, BOOL hadExtension) {
 		NSString *vid = nil;
 
 		if ([host isEqualToString:@"nico.ms"]) {
 			NSString *dpath = [u path];
-			
+
 			NSObjectIsEmptyAssertReturn(dpath, nil);
-			
+
 			dpath = [dpath substringFromIndex:1];
 
 			if ([dpath hasPrefix:@"sm"] || [dpath hasPrefix:@"nm"]) {
@@ -307,7 +370,7 @@
 			}
 		} else {
 			NSString *dpath = [u path];
-			
+
 			if ([dpath hasPrefix:@"/watch/"]) {
 				dpath = [dpath substringFromIndex:7];
 
@@ -322,7 +385,152 @@
 
 			return [NSString stringWithFormat:@"http://tn-skr%lli.smilevideo.jp/smile?i=%lli", ((vidNum % 4) + 1), vidNum];
 		}
-	} else if ([path hasPrefix:@"/image/"]) {
+
+		return nil;
+	};
+
+	domainHostRules[@"nicovideo.jp"] = nicovideoRule;
+	exactHostRules[@"nico.ms"] = nicovideoRule;
+
+	_exactHostRules = [exactHostRules copy];
+	_domainHostRules = [domainHostRules copy];
+}
+
+/* Returns the object stored for the host, or for the closest of its parent
+ domains, in a table keyed by domain. */
++ (id)objectForHost:(NSString *)host inDomainTable:(NSDictionary *)table
+{
+	NSString *domain = host;
+
+	while (NSObjectIsNotEmpty(domain)) {
+		id object = table[domain];
+
+		if (object) {
+			return object;
+		}
+
+		NSRange dotRange = [domain rangeOfString:@"."];
+
+		if (dotRange.location == NSNotFound) {
+			break;
+		}
+
+		domain = [domain substringFromIndex:NSMaxRange(dotRange)];
+	}
+
+	return nil;
+}
+
+/* A string ends with ".ext" exactly when the text after its last period is "ext"
+ which allows the extension to be checked with a single set lookup. */
++ (BOOL)stringHasImageFileExtension:(NSString *)string
+{
+	NSObjectIsEmptyAssertReturn(string, NO);
+
+	NSRange dotRange = [string rangeOfString:@"." options:NSBackwardsSearch];
+
+	if (dotRange.location == NSNotFound) {
+		return NO;
+	}
+
+	NSString *extension = [[string substringFromIndex:NSMaxRange(dotRange)] lowercaseString];
+
+	return [_imageFileExtensions containsObject:extension];
+}
+
+#pragma mark -
+#pragma mark Parser
+
++ (NSString *)imageURLFromBase:(NSString *)url
+{
+	/* Convert URL. */
+	NSURL *u = [url URLUsingWebKitPasteboard];
+
+	NSString *plguinResult = [sharedPluginManager() processInlineMediaContentURL:[u absoluteString]];
+
+	if (plguinResult) {
+		return plguinResult;
+	}
+
+	/* Plugins are consulted before the cache because what they
+	 return is allowed to change while Textual is running. */
+	NSObjectIsEmptyAssertReturn(url, nil);
+
+	[self populateRuleTableIfNeeded];
+
+	id cachedResult = [_resultCache objectForKey:url];
+
+	if (cachedResult) {
+		if (cachedResult == [NSNull null]) {
+			return nil;
+		} else {
+			return cachedResult;
+		}
+	}
+
+	NSString *result = [self imageURLFromBase:url withURL:u];
+
+	if (result) {
+		[_resultCache setObject:result forKey:url];
+	} else {
+		[_resultCache setObject:[NSNull null] forKey:url];
+	}
+
+	return result;
+}
+
++ (NSString *)imageURLFromBase:(NSString *)url withURL:(NSURL *)u
+{
+	NSString *scheme = [u scheme];
+
+	if ([scheme isEqualToString:@"file"]) {
+		// If the file is a local file (file:// scheme), then let us ignore it.
+		// Only the local user can see their own files.
+
+		return nil;
+	}
+
+	NSString *host = [[u host] lowercaseString];
+
+	NSString *path = [[u path] encodeURIFragment];
+
+	NSString *query = [[u query] encodeURIFragment];
+
+	BOOL hadExtension = NO;
+
+	if ([self stringHasImageFileExtension:path] || [self stringHasImageFileExtension:query]) {
+		hadExtension = YES;
+
+		TVCImageURLParserExtensionPolicy extensionPolicy = [[self objectForHost:host inDomainTable:_extensionPolicies] unsignedIntegerValue];
+
+		if (extensionPolicy == TVCImageURLParserExtensionPolicyIgnore) {
+			return nil;
+		} else if ([url hasPrefix:@"http://fukung.net/v/"]) {
+			return [url stringByReplacingOccurrencesOfString:@"http://fukung.net/v/" withString:@"http://media.fukung.net/images/"];
+		} else if (extensionPolicy == TVCImageURLParserExtensionPolicyPresent) {
+			return [u absoluteString];
+		}
+	}
+
+	if (query) {
+		path = [[path stringByAppendingString:@"?"] stringByAppendingString:query];
+	}
+
+	TVCImageURLParserHostRule hostRule = nil;
+
+	if (host) {
+		hostRule = _exactHostRules[host];
+
+		if (hostRule == nil) {
+			hostRule = [self objectForHost:host inDomainTable:_domainHostRules];
+		}
+	}
+
+	if (hostRule) {
+		return hostRule(url, u, host, path, hadExtension);
+	}
+
+	if ([path hasPrefix:@"/image/"]) {
 		/* Try our best to regonize cl.ly custom domains. */
 		NSString *s = [path substringFromIndex:7];
 
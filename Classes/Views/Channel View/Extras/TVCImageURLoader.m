@@ -35,103 +35,479 @@
 
  *********************************************************************** */
 
+
 #import "TextualApplication.h"
 
-#define _imageLoaderMaxCacheSize			10
+#define _imageLoaderMaxCacheSize				250
+#define _imageLoaderMaxDiskCacheSize			2000
+#define _imageLoaderDiskCacheTrimInterval		100
+#define _imageLoaderDiskCacheEntryLifetime		86400 // 24 hours
+
+#define _imageLoaderMaxConcurrentRequests		4
+
+#define _imageLoaderMaxRequestTime				30
 
-#define _imageLoaderMaxRequestTime			30
+#define _imageMaximumImageWidth					7200
 
-#define _imageMaximumImageWidth				7200
+/* A probe result records what was learned about a URL instead of whether it
+ was safe to present. This allows a cached result to be evaluated against the
+ preferences that are in effect at the time it is used. */
+static NSString * const TVCImageURLoaderProbeResponseIsValidKey				= @"responseIsValid";
+static NSString * const TVCImageURLoaderProbeContentLengthKey				= @"contentLength";
+static NSString * const TVCImageURLoaderProbeContentLengthIsLowerBoundKey	= @"contentLengthIsLowerBound";
+static NSString * const TVCImageURLoaderProbeImageWidthKey					= @"imageWidth";
+static NSString * const TVCImageURLoaderProbeImageHeightKey					= @"imageHeight";
+static NSString * const TVCImageURLoaderProbeDateKey						= @"probeDate";
 
 @interface TVCImageURLoader ()
-@property (nonatomic, strong) NSMutableData *responseData;
 @property (nonatomic, copy) NSString *requestImageUniqeID;
+
+- (void)informDelegateWhetherImageIsSafe:(BOOL)isSafeToLoadImage withUniqueID:(NSString *)uniqueID;
+@end
+
+/* A single network probe of a URL. Every loader asking about the same URL
+ while the probe is in flight is added to waitingLoaders instead of
+ starting a connection of its own. */
+@interface TVCImageURLoaderRequest : NSObject <NSURLConnectionDelegate, NSURLConnectionDataDelegate>
+@property (nonatomic, copy) NSString *requestKey;
 @property (nonatomic, copy) NSString *requestImageURL;
 @property (nonatomic, copy) NSString *requestImageURLCacheToken;
+@property (nonatomic, strong) NSMutableArray *waitingLoaders;
+@property (nonatomic, strong) NSMutableData *responseData;
 @property (nonatomic, strong) NSURLConnection *requestConnection;
 @property (nonatomic, strong) NSHTTPURLResponse *requestResponse;
 @property (nonatomic, assign) BOOL isInRequestWithCheckForMaximumHeight;
+@property (nonatomic, assign) BOOL requestIsFinished;
+@property (nonatomic, assign) BOOL requestResponseIsDefinitive; // The server answered with 200 OK
+
+- (void)start;
 @end
 
-static NSCache *_internalCache = nil;
+/* Process-wide coordinator shared by all loaders. It maintains the memory
+ and disk caches of probe results, deduplicates requests that are in flight,
+ and limits the number of connections open at any one time. Unless noted
+ otherwise, methods are expected to be called on the main thread. */
+@interface TVCImageURLoaderSharedLoader : NSObject
+@property (nonatomic, strong) NSMutableDictionary *memoryCache;
+@property (nonatomic, strong) NSMutableArray *memoryCacheUsageOrder; // Least recently used first
+@property (nonatomic, strong) NSMutableDictionary *activeRequests;
+@property (nonatomic, strong) NSMutableArray *pendingRequests;
+@property (nonatomic, assign) NSInteger runningRequestCount;
+@property (nonatomic, assign) NSInteger diskCacheWritesSinceTrim;
+@property (nonatomic, copy) NSString *diskCachePath;
+@property (nonatomic, strong) dispatch_queue_t diskCacheQueue;
 
-@implementation TVCImageURLoader
++ (TVCImageURLoaderSharedLoader *)sharedLoader;
 
-#pragma mark -
-#pragma mark Public API
+- (void)assesURL:(NSString *)baseURL forLoader:(TVCImageURLoader *)loader;
 
-+ (void)load
+- (void)request:(TVCImageURLoaderRequest *)request didFinishWithProbeResult:(NSDictionary *)probeResult;
+
+- (void)invalidateMemoryCache;
+@end
+
+/* Evaluates a probe result against the current preferences. Returns NO when the
+ result does not hold enough information to make that decision, in which case
+ the URL has to be probed again. */
+static BOOL TVCImageURLoaderEvaluateProbeResult(NSDictionary *probeResult, BOOL checkForMaximumHeight, BOOL *isSafeToLoadImage)
 {
-	if (_internalCache == nil) {
-		_internalCache = [NSCache new];
+	*isSafeToLoadImage = NO;
 
-		[_internalCache setCountLimit:_imageLoaderMaxCacheSize];
+	if ([probeResult boolForKey:TVCImageURLoaderProbeResponseIsValidKey] == NO) {
+		return YES;
 	}
+
+	/* Check size. */
+	TXUnsignedLongLong sizeInBytes = [probeResult longLongForKey:TVCImageURLoaderProbeContentLengthKey];
+
+	if (sizeInBytes > [TPCPreferences inlineImagesMaxFilesize]) {
+		return YES;
+	}
+
+	/* The download was cut short by a smaller maximum file size than the
+	 one now in place which means the real size of the image is unknown. */
+	if ([probeResult boolForKey:TVCImageURLoaderProbeContentLengthIsLowerBoundKey]) {
+		return NO;
+	}
+
+	/* Check dimensions. */
+	if (checkForMaximumHeight) {
+		if (probeResult[TVCImageURLoaderProbeImageWidthKey] == nil ||
+			probeResult[TVCImageURLoaderProbeImageHeightKey] == nil)
+		{
+			return NO;
+		}
+
+		NSInteger width = [probeResult integerForKey:TVCImageURLoaderProbeImageWidthKey];
+		NSInteger height = [probeResult integerForKey:TVCImageURLoaderProbeImageHeightKey];
+
+		if (height <= [TPCPreferences inlineImagesMaxHeight] && width <= _imageMaximumImageWidth) {
+			*isSafeToLoadImage = YES;
+		}
+	} else {
+		*isSafeToLoadImage = YES;
+	}
+
+	return YES;
 }
 
+@implementation TVCImageURLoader
+
+#pragma mark -
+#pragma mark Public API
+
 + (void)invalidateInternalCache
 {
-	[_internalCache removeAllObjects];
+	[[TVCImageURLoaderSharedLoader sharedLoader] invalidateMemoryCache];
 }
 
-- (void)cleanupConnectionRequest
+- (void)assesURL:(NSString *)baseURL withID:(NSString *)uniqueID
 {
-	if ( self.requestConnection) {
-		[self.requestConnection cancel];
-	}
+	NSObjectIsEmptyAssert(baseURL);
+	NSObjectIsEmptyAssert(uniqueID);
 
-	self.requestImageURL = nil;
-	self.requestImageURLCacheToken = nil;
+	self.requestImageUniqeID = uniqueID;
 
-	self.requestImageUniqeID = nil;
-	self.requestConnection = nil;
-	self.requestResponse = nil;
+	/* The shared loader retains us until an answer is available. */
+	[[TVCImageURLoaderSharedLoader sharedLoader] assesURL:baseURL forLoader:self];
+}
 
-	self.responseData = nil;
+- (void)informDelegateWhetherImageIsSafe:(BOOL)isSafeToLoadImage withUniqueID:(NSString *)uniqueID
+{
+	if (isSafeToLoadImage) {
+		if ([self.delegate respondsToSelector:@selector(isSafeToPresentImageWithID:)]) {
+			[self.delegate isSafeToPresentImageWithID:uniqueID];
+		}
+	} else {
+		if ([self.delegate respondsToSelector:@selector(isNotSafeToPresentImageWithID:)]) {
+			[self.delegate isNotSafeToPresentImageWithID:uniqueID];
+		}
+	}
 }
 
-- (void)dealloc
+@end
+
+#pragma mark -
+
+@implementation TVCImageURLoaderSharedLoader
+
++ (TVCImageURLoaderSharedLoader *)sharedLoader
 {
-	self.delegate = nil;
+	static id sharedSelf = nil;
+
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		sharedSelf = [TVCImageURLoaderSharedLoader new];
+	});
+
+	return sharedSelf;
 }
 
-- (void)assesURL:(NSString *)baseURL withID:(NSString *)uniqueID
+- (instancetype)init
 {
-	NSObjectIsEmptyAssert(baseURL);
-	NSObjectIsEmptyAssert(uniqueID);
+	if ((self = [super init])) {
+		self.memoryCache = [NSMutableDictionary dictionary];
+		self.memoryCacheUsageOrder = [NSMutableArray array];
+
+		self.activeRequests = [NSMutableDictionary dictionary];
+		self.pendingRequests = [NSMutableArray array];
+
+		self.diskCachePath = [[TPCPathInfo applicationCachesFolderPath] stringByAppendingPathComponent:@"/Inline Image Probes/"];
+
+		self.diskCacheQueue = dispatch_queue_create("Textual.TVCImageURLoader.diskCacheQueue", DISPATCH_QUEUE_SERIAL);
+
+		return self;
+	}
+
+	return nil;
+}
 
+#pragma mark -
+#pragma mark Request Management
+
+- (void)assesURL:(NSString *)baseURL forLoader:(TVCImageURLoader *)loader
+{
 	/* Determine whether this URL has already been cached. If so, inform
 	 the callback of the cached value for the URL. */
 	NSString *baseURLCacheToken = [baseURL md5];
 
-	id cachedValue = [_internalCache objectForKey:baseURLCacheToken];
+	/* This is stored in a local variable so that a user changing something during a load in
+	 progess, it does not fuck up any of the already existing requests. */
+	BOOL checkForMaximumHeight = ([TPCPreferences inlineImagesMaxHeight] > 0);
 
-	if (cachedValue) {
-		[self informDelegateWhetherImageIsSafe:[cachedValue boolValue] withUniqueID:uniqueID];
+	NSDictionary *cachedProbeResult = [self memoryCachedProbeResultForToken:baseURLCacheToken];
+
+	if (cachedProbeResult) {
+		BOOL isSafeToLoadImage = NO;
+
+		if (TVCImageURLoaderEvaluateProbeResult(cachedProbeResult, checkForMaximumHeight, &isSafeToLoadImage)) {
+			[loader informDelegateWhetherImageIsSafe:isSafeToLoadImage withUniqueID:[loader requestImageUniqeID]];
+
+			return;
+		}
+	}
+
+	/* A probe that only reads the headers cannot answer a loader which
+	 needs the dimensions of the image so the two are tracked separately. */
+	NSString *requestKey = baseURLCacheToken;
+
+	if (checkForMaximumHeight) {
+		requestKey = [baseURLCacheToken stringByAppendingString:@"-dimensions"];
+	}
+
+	/* Join the request already in flight for this URL, if any. */
+	TVCImageURLoaderRequest *request = self.activeRequests[requestKey];
+
+	if (request) {
+		[[request waitingLoaders] addObject:loader];
 
 		return;
 	}
 
-	/* Reset the connection if needed. */
-	[self cleanupConnectionRequest];
+	request = [TVCImageURLoaderRequest new];
 
-	self.requestImageURL = baseURL;
-	self.requestImageURLCacheToken = baseURLCacheToken;
+	[request setRequestKey:requestKey];
+	[request setRequestImageURL:baseURL];
+	[request setRequestImageURLCacheToken:baseURLCacheToken];
+	[request setIsInRequestWithCheckForMaximumHeight:checkForMaximumHeight];
+	[request setWaitingLoaders:[NSMutableArray arrayWithObject:loader]];
 
-	self.requestImageUniqeID = uniqueID;
+	self.activeRequests[requestKey] = request;
+
+	/* Consult the disk cache before going to the network. */
+	dispatch_async(self.diskCacheQueue, ^{
+		NSDictionary *diskProbeResult = [self diskCachedProbeResultForToken:baseURLCacheToken];
+
+		[self performBlockOnMainThread:^{
+			if (diskProbeResult) {
+				BOOL isSafeToLoadImage = NO;
+
+				if (TVCImageURLoaderEvaluateProbeResult(diskProbeResult, checkForMaximumHeight, &isSafeToLoadImage)) {
+					[self insertProbeResult:diskProbeResult intoMemoryCacheForToken:baseURLCacheToken];
+
+					[self completeRequest:request isSafeToLoadImage:isSafeToLoadImage];
+
+					return;
+				}
+			}
+
+			[self enqueueRequest:request];
+		}];
+	});
+}
+
+- (void)enqueueRequest:(TVCImageURLoaderRequest *)request
+{
+	if (self.runningRequestCount < _imageLoaderMaxConcurrentRequests) {
+		self.runningRequestCount += 1;
+
+		[request start];
+	} else {
+		[self.pendingRequests addObject:request];
+	}
+}
+
+- (void)startPendingRequests
+{
+	while (self.runningRequestCount < _imageLoaderMaxConcurrentRequests) {
+		NSObjectIsEmptyAssertLoopBreak(self.pendingRequests);
+
+		TVCImageURLoaderRequest *request = self.pendingRequests[0];
+
+		[self.pendingRequests removeObjectAtIndex:0];
+
+		self.runningRequestCount += 1;
+
+		[request start];
+	}
+}
+
+- (void)completeRequest:(TVCImageURLoaderRequest *)request isSafeToLoadImage:(BOOL)isSafeToLoadImage
+{
+	[self.activeRequests removeObjectForKey:[request requestKey]];
+
+	for (TVCImageURLoader *loader in [request waitingLoaders]) {
+		[loader informDelegateWhetherImageIsSafe:isSafeToLoadImage withUniqueID:[loader requestImageUniqeID]];
+	}
+
+	[request setWaitingLoaders:nil];
+}
+
+- (void)request:(TVCImageURLoaderRequest *)request didFinishWithProbeResult:(NSDictionary *)probeResult
+{
+	self.runningRequestCount -= 1;
+
+	BOOL isSafeToLoadImage = NO;
+
+	/* A nil result means the connection failed. Failures and answers other
+	 than 200 OK, which may only be temporary, are not cached so that the URL
+	 can be tried again the next time it is posted. */
+	if (probeResult) {
+		if ([request requestResponseIsDefinitive]) {
+			NSString *cacheToken = [request requestImageURLCacheToken];
+
+			[self insertProbeResult:probeResult intoMemoryCacheForToken:cacheToken];
+
+			dispatch_async(self.diskCacheQueue, ^{
+				[self writeProbeResult:probeResult toDiskCacheForToken:cacheToken];
+			});
+		}
+
+		TVCImageURLoaderEvaluateProbeResult(probeResult, [request isInRequestWithCheckForMaximumHeight], &isSafeToLoadImage);
+	}
+
+	[self completeRequest:request isSafeToLoadImage:isSafeToLoadImage];
+
+	[self startPendingRequests];
+}
+
+#pragma mark -
+#pragma mark Memory Cache
 
+- (NSDictionary *)memoryCachedProbeResultForToken:(NSString *)cacheToken
+{
+	@synchronized(self.memoryCache) {
+		NSDictionary *probeResult = self.memoryCache[cacheToken];
+
+		if (probeResult) {
+			/* Move the entry to the end of the usage order. */
+			[self.memoryCacheUsageOrder removeObject:cacheToken];
+			[self.memoryCacheUsageOrder addObject:cacheToken];
+		}
+
+		return probeResult;
+	}
+}
+
+- (void)insertProbeResult:(NSDictionary *)probeResult intoMemoryCacheForToken:(NSString *)cacheToken
+{
+	@synchronized(self.memoryCache) {
+		if (self.memoryCache[cacheToken]) {
+			[self.memoryCacheUsageOrder removeObject:cacheToken];
+		}
+
+		self.memoryCache[cacheToken] = probeResult;
+
+		[self.memoryCacheUsageOrder addObject:cacheToken];
+
+		/* Evict the least recently used entries. */
+		while ([self.memoryCacheUsageOrder count] > _imageLoaderMaxCacheSize) {
+			[self.memoryCache removeObjectForKey:self.memoryCacheUsageOrder[0]];
+
+			[self.memoryCacheUsageOrder removeObjectAtIndex:0];
+		}
+	}
+}
+
+- (void)invalidateMemoryCache
+{
+	@synchronized(self.memoryCache) {
+		[self.memoryCache removeAllObjects];
+
+		[self.memoryCacheUsageOrder removeAllObjects];
+	}
+}
+
+#pragma mark -
+#pragma mark Disk Cache
+
+/* The disk cache is only ever accessed on diskCacheQueue. Each probe result is
+ stored as its own property list so that a lookup reads only what it needs. The
+ modification date of a file doubles as the last time the entry was used. */
+
+- (NSString *)diskCachePathForToken:(NSString *)cacheToken
+{
+	return [self.diskCachePath stringByAppendingPathComponent:[cacheToken stringByAppendingPathExtension:@"plist"]];
+}
+
+- (NSDictionary *)diskCachedProbeResultForToken:(NSString *)cacheToken
+{
+	NSString *filePath = [self diskCachePathForToken:cacheToken];
+
+	NSDictionary *probeResult = [NSDictionary dictionaryWithContentsOfFile:filePath];
+
+	PointerIsEmptyAssertReturn(probeResult, nil);
+
+	/* Expire old entries so that a replaced image is eventually noticed. */
+	NSDate *probeDate = probeResult[TVCImageURLoaderProbeDateKey];
+
+	if (probeDate == nil || [probeDate timeIntervalSinceNow] < (-_imageLoaderDiskCacheEntryLifetime)) {
+		[RZFileManager() removeItemAtPath:filePath error:NULL];
+
+		return nil;
+	}
+
+	[RZFileManager() setAttributes:@{NSFileModificationDate : [NSDate date]} ofItemAtPath:filePath error:NULL];
+
+	return probeResult;
+}
+
+- (void)writeProbeResult:(NSDictionary *)probeResult toDiskCacheForToken:(NSString *)cacheToken
+{
+	if ([RZFileManager() fileExistsAtPath:self.diskCachePath] == NO) {
+		[RZFileManager() createDirectoryAtPath:self.diskCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+	}
+
+	[probeResult writeToFile:[self diskCachePathForToken:cacheToken] atomically:YES];
+
+	/* Trimming requires listing the whole directory so it is not
+	 performed on every write. */
+	self.diskCacheWritesSinceTrim += 1;
+
+	if (self.diskCacheWritesSinceTrim >= _imageLoaderDiskCacheTrimInterval) {
+		self.diskCacheWritesSinceTrim = 0;
+
+		[self trimDiskCache];
+	}
+}
+
+- (void)trimDiskCache
+{
+	NSURL *cacheURL = [NSURL fileURLWithPath:self.diskCachePath isDirectory:YES];
+
+	NSArray *cacheContents = [RZFileManager() contentsOfDirectoryAtURL:cacheURL
+											includingPropertiesForKeys:@[NSURLContentModificationDateKey]
+															   options:NSDirectoryEnumerationSkipsHiddenFiles
+																 error:NULL];
+
+	if ([cacheContents count] <= _imageLoaderMaxDiskCacheSize) {
+		return;
+	}
+
+	NSArray *sortedContents = [cacheContents sortedArrayUsingComparator:^NSComparisonResult(NSURL *obj1, NSURL *obj2) {
+		NSDate *date1 = nil;
+		NSDate *date2 = nil;
+
+		[obj1 getResourceValue:&date1 forKey:NSURLContentModificationDateKey error:NULL];
+		[obj2 getResourceValue:&date2 forKey:NSURLContentModificationDateKey error:NULL];
+
+		return [date1 compare:date2];
+	}];
+
+	NSInteger excessCount = ([sortedContents count] - _imageLoaderMaxDiskCacheSize);
+
+	for (NSInteger i = 0; i < excessCount; i++) {
+		[RZFileManager() removeItemAtURL:sortedContents[i] error:NULL];
+	}
+}
+
+@end
+
+#pragma mark -
+
+@implementation TVCImageURLoaderRequest
+
+- (void)start
+{
 	/* Create the request. */
 	/* We use a mutable request because we are going to set the HTTP method. */
-	NSMutableURLRequest *baseRequest = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:baseURL]
+	NSMutableURLRequest *baseRequest = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:self.requestImageURL]
 															   cachePolicy:NSURLRequestReloadIgnoringCacheData
 														   timeoutInterval:_imageLoaderMaxRequestTime];
 
 	[baseRequest setValue:TVCLogViewCommonUserAgentString forHTTPHeaderField:@"User-Agent"];
 
-	/* This is stored in a local variable so that a user changing something during a load in
-	 progess, it does not fuck up any of the already existing requests. */
-		self.isInRequestWithCheckForMaximumHeight = ([TPCPreferences inlineImagesMaxHeight] > 0);
-
 	if (self.isInRequestWithCheckForMaximumHeight) {
 		self.responseData = [NSMutableData data];
 	}
@@ -139,27 +515,52 @@ static NSCache *_internalCache = nil;
 	[baseRequest setHTTPMethod:@"GET"];
 
 	/* Send the actual request off. */
-	 self.requestConnection = [[NSURLConnection alloc] initWithRequest:baseRequest delegate:self startImmediately:NO];
+	self.requestConnection = [[NSURLConnection alloc] initWithRequest:baseRequest delegate:self startImmediately:NO];
 
 	[self.requestConnection start];
 }
 
-#pragma mark -
-#pragma mark NSURLConnection Delegate
+- (void)cleanupConnectionRequest
+{
+	if ( self.requestConnection) {
+		[self.requestConnection cancel];
+	}
 
-- (void)informDelegateWhetherImageIsSafe:(BOOL)isSafeToLoadImage withUniqueID:(NSString *)uniqueID
+	self.requestConnection = nil;
+	self.requestResponse = nil;
+
+	self.responseData = nil;
+}
+
+- (void)finishWithProbeResult:(NSDictionary *)probeResult
 {
-	if (isSafeToLoadImage) {
-		if ([self.delegate respondsToSelector:@selector(isSafeToPresentImageWithID:)]) {
-			[self.delegate isSafeToPresentImageWithID:uniqueID];
-		}
-	} else {
-		if ([self.delegate respondsToSelector:@selector(isNotSafeToPresentImageWithID:)]) {
-			[self.delegate isNotSafeToPresentImageWithID:uniqueID];
-		}
+	if (self.requestIsFinished) {
+		return;
 	}
+
+	self.requestIsFinished = YES;
+
+	self.requestResponseIsDefinitive = ([self.requestResponse statusCode] == 200);
+
+	[self cleanupConnectionRequest];
+
+	[[TVCImageURLoaderSharedLoader sharedLoader] request:self didFinishWithProbeResult:probeResult];
+}
+
+- (NSMutableDictionary *)probeResultWithResponseValidity:(BOOL)responseIsValid contentLength:(TXUnsignedLongLong)contentLength
+{
+	NSMutableDictionary *probeResult = [NSMutableDictionary dictionary];
+
+	probeResult[TVCImageURLoaderProbeResponseIsValidKey] = @(responseIsValid);
+	probeResult[TVCImageURLoaderProbeContentLengthKey] = @(contentLength);
+	probeResult[TVCImageURLoaderProbeDateKey] = [NSDate date];
+
+	return probeResult;
 }
 
+#pragma mark -
+#pragma mark NSURLConnection Delegate
+
 - (BOOL)continueWithImageProcessing
 {
 	/* Get data from headers. */
@@ -186,57 +587,59 @@ static NSCache *_internalCache = nil;
 
 - (void)connectionDidFinishLoading:(NSURLConnection *)connection
 {
-	BOOL isSafeToLoadImage = NO;
-
 	BOOL isValidResponse = ([self.requestResponse statusCode] == 200);
 
-    if (isValidResponse) {
-		if (self.isInRequestWithCheckForMaximumHeight) {
-			if (self.responseData == nil) {
-				goto destroy_connection;
-			}
-			
-			CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)self.responseData, NULL);
-			
-			if (PointerIsEmpty(imageSource)) {
-				goto destroy_connection;
-			}
-			
-			CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL);
-		
-			if (PointerIsEmpty(properties)) {
-				CFRelease(imageSource);
+	TXUnsignedLongLong sizeInBytes = [[self.requestResponse allHeaderFields] longLongForKey:@"Content-Length"];
 
-				goto destroy_connection;
-			}
+	if (isValidResponse == NO || self.isInRequestWithCheckForMaximumHeight == NO) {
+		[self finishWithProbeResult:[self probeResultWithResponseValidity:isValidResponse contentLength:sizeInBytes]];
 
-			NSNumber *width = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
-			NSNumber *height = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+		return;
+	}
 
-			CFRelease(imageSource);
-			CFRelease(properties);
+	/* Determine the dimensions of the downloaded image. */
+	sizeInBytes = [self.responseData length];
 
-			if ([height integerValue] <= [TPCPreferences inlineImagesMaxHeight] && [width integerValue] <= _imageMaximumImageWidth) {
-				isSafeToLoadImage = YES;
-			}
-		} else {
-			isSafeToLoadImage = YES;
-		}
+	NSMutableDictionary *probeResult = [self probeResultWithResponseValidity:NO contentLength:sizeInBytes];
+
+	CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)self.responseData, NULL);
+
+	if (PointerIsEmpty(imageSource)) {
+		[self finishWithProbeResult:probeResult];
+
+		return;
 	}
 
-destroy_connection:
-	[_internalCache setObject:@(isSafeToLoadImage) forKey:self.requestImageURLCacheToken];
+	CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL);
 
-	[self informDelegateWhetherImageIsSafe:isSafeToLoadImage withUniqueID:self.requestImageUniqeID];
+	if (PointerIsEmpty(properties)) {
+		CFRelease(imageSource);
 
-	[self cleanupConnectionRequest];
+		[self finishWithProbeResult:probeResult];
+
+		return;
+	}
+
+	NSNumber *width = CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
+	NSNumber *height = CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+
+	if (width && height) {
+		probeResult[TVCImageURLoaderProbeResponseIsValidKey] = @(YES);
+		probeResult[TVCImageURLoaderProbeImageWidthKey] = width;
+		probeResult[TVCImageURLoaderProbeImageHeightKey] = height;
+	}
+
+	CFRelease(imageSource);
+	CFRelease(properties);
+
+	[self finishWithProbeResult:probeResult];
 }
 
 - (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error
 {
-	[self cleanupConnectionRequest];
-
 	LogToConsole(@"Failed to complete connection request with error: %@", [error localizedDescription]);
+
+	[self finishWithProbeResult:nil];
 }
 
 - (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data
@@ -248,8 +651,12 @@ destroy_connection:
 		 still go ahead and check the downloaded data length here. */
 		if ([self.responseData length] > [TPCPreferences inlineImagesMaxFilesize]) {
 			LogToConsole(@"Inline image exceeds maximum file length.");
-			
-			[self cleanupConnectionRequest];
+
+			NSMutableDictionary *probeResult = [self probeResultWithResponseValidity:YES contentLength:[self.responseData length]];
+
+			probeResult[TVCImageURLoaderProbeContentLengthIsLowerBoundKey] = @(YES);
+
+			[self finishWithProbeResult:probeResult];
 		}
 	}
 }
@@ -259,7 +666,16 @@ destroy_connection:
 	self.requestResponse = (id)response;
 
 	if ([self continueWithImageProcessing] == NO) {
-		[self cleanupConnectionRequest];
+		/* The headers alone rule the image out. The response is recorded as
+		 invalid unless it was only rejected for its size so that a later
+		 increase of the maximum file size is honored. */
+		NSDictionary *headers = [self.requestResponse allHeaderFields];
+
+		TXUnsignedLongLong sizeInBytes = [headers longLongForKey:@"Content-Length"];
+
+		BOOL isValidContentType = [[TVCImageURLParser validImageContentTypes] containsObject:[headers stringForKey:@"Content-Type"]];
+
+		[self finishWithProbeResult:[self probeResultWithResponseValidity:isValidContentType contentLength:sizeInBytes]];
 	} else {
 		if (self.isInRequestWithCheckForMaximumHeight == NO) {
 			/* If we do not care about the height, then we are going
@@ -93,6 +93,17 @@
 		[operation setIsStandalone:isStandalone];
 		[operation setExecutionBlock:callbackBlock];
 
+		/* Standalone operations reload the entire contents of a view. When
+		 many are queued at once, such as during a theme reload, the one for
+		 the view the user is looking at is done first. */
+		if (isStandalone) {
+			if ([mainWindow() selectedViewController] == sender) {
+				[operation setQueuePriority:NSOperationQueuePriorityVeryHigh];
+			} else {
+				[operation setQueuePriority:NSOperationQueuePriorityLow];
+			}
+		}
+
 		/* Add the operations. */
 		[self addOperation:operation];
 	}];
@@ -112,6 +123,22 @@
 	}
 }
 
+- (void)prioritizeOperationsForViewController:(TVCLogController *)controller
+{
+	[self performBlockOnMainThread:^{
+		PointerIsEmptyAssert(controller);
+
+		/* The priority of an operation only matters until it starts. */
+		for (id operation in [self operations]) {
+			if ([operation controller] == controller) {
+				if ([operation isStandalone] && [operation isExecuting] == NO) {
+					[operation setQueuePriority:NSOperationQueuePriorityVeryHigh];
+				}
+			}
+		}
+	}];
+}
+
 - (void)destroyOperationsForChannel:(IRCChannel *)channel
 {
 	[self cancelOperationsForViewController:[channel viewController]];
@@ -155,12 +182,14 @@
 {
 	/* This is called internally already from a method that is running on the
 	 main queue so we will not wrap this in it. */
+	/* Standalone operations are included so that a line printed while the
+	 contents of a view are being reloaded is not written to the historic
+	 log before the reload reads and resets it. A standalone operation can
+	 be given a lower priority than the prints queued behind it. */
 	for (id operation in [[self operations] reverseObjectEnumerator]) {
 		if ([operation controller] == controller) {
 			if ([operation isCancelled] == NO) {
-				if ([operation isStandalone] == NO) {
-					return operation;
-				}
+				return operation;
 			}
 		}
 	}
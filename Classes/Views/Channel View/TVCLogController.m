@@ -42,6 +42,8 @@
 
 #import <objc/objc-runtime.h>
 
+#import <sys/sysctl.h>
+
 @interface TVCLogController ()
 @property (nonatomic, assign) BOOL historyLoaded;
 @property (nonatomic, assign) BOOL windowScriptObjectLoaded;
@@ -53,12 +55,124 @@
 @property (nonatomic, assign) BOOL needsLimitNumberOfLines;
 @property (nonatomic, assign) NSInteger activeLineCount;
 @property (strong) NSMutableArray *highlightedLineNumbers;
+@property (nonatomic, strong) NSMutableArray *deferredLogLines; // TVCLogLine objects received while hidden. Oldest first.
+@property (nonatomic, strong) NSMutableArray *renderedLineNumbers; // In the order they appear in the view. Oldest first.
+@property (nonatomic, assign) BOOL deferredLogLinesOverflowed;
+@property (nonatomic, assign) BOOL deferredLogLinesRenderPending;
 @end
 
+/* The number of lines a hidden view will hold on to before it gives up on
+ them and reloads its contents from the historic log when it is selected. */
+#define _deferredLogLinesMaximumCount			250
+
 NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogControllerViewFinishedLoadingNotification";
 
+#pragma mark -
+#pragma mark Visible View
+
+/* The view selected in the main window. It is recorded on the main thread
+ when a view becomes visible so that printing queues can read it. */
+static __weak TVCLogController *_visibleViewController = nil;
+
+static void TVCLogControllerSetVisibleViewController(TVCLogController *controller)
+{
+	@synchronized([TVCLogController class]) {
+		_visibleViewController = controller;
+	}
+}
+
+static TVCLogController *TVCLogControllerVisibleViewController(void)
+{
+	@synchronized([TVCLogController class]) {
+		return _visibleViewController;
+	}
+}
+
+#pragma mark -
+#pragma mark Startup Timing
+
+static NSInteger _historyRestoresInProgress = 0;
+
+static BOOL _historyRestoreReportedFirstView = NO;
+static BOOL _historyRestoreReportedAllViews = NO;
+
+/* Time elapsed since the process was started. */
+static NSTimeInterval TVCLogControllerTimeIntervalSinceLaunch(void)
+{
+	int mib[4] = {CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid()};
+
+	struct kinfo_proc processInfo;
+
+	size_t processInfoSize = sizeof(processInfo);
+
+	if (sysctl(mib, 4, &processInfo, &processInfoSize, NULL, 0) != 0) {
+		return 0;
+	}
+
+	struct timeval startTime = processInfo.kp_proc.p_starttime;
+
+	NSTimeInterval startTimeInterval = (startTime.tv_sec + (startTime.tv_usec / 1000000.0));
+
+	return ([[NSDate date] timeIntervalSince1970] - startTimeInterval);
+}
+
+static void TVCLogControllerHistoryRestoreDidBegin(void)
+{
+	@synchronized([TVCLogController class]) {
+		_historyRestoresInProgress += 1;
+	}
+}
+
+/* Expected to be called while holding the lock on TVCLogController. */
+static void TVCLogControllerHistoryRestoreReportIfFinished(void)
+{
+	if (_historyRestoreReportedAllViews == NO && _historyRestoresInProgress == 0) {
+		_historyRestoreReportedAllViews = YES;
+
+		LogToConsole(@"Startup timing: history of all views restored %.3f seconds after launch",
+					 TVCLogControllerTimeIntervalSinceLaunch());
+	}
+}
+
+/* The first view to finish restoring while selected is the first usable view. */
+static void TVCLogControllerHistoryRestoreDidEnd(TVCLogController *controller, NSUInteger lineCount)
+{
+	@synchronized([TVCLogController class]) {
+		_historyRestoresInProgress -= 1;
+
+		if (_historyRestoreReportedFirstView == NO && [mainWindow() selectedViewController] == controller) {
+			_historyRestoreReportedFirstView = YES;
+
+			LogToConsole(@"Startup timing: first view usable %.3f seconds after launch (%lu lines restored)",
+						 TVCLogControllerTimeIntervalSinceLaunch(), (unsigned long)lineCount);
+		}
+
+		TVCLogControllerHistoryRestoreReportIfFinished();
+	}
+}
+
 @implementation TVCLogController
 
+#pragma mark -
+#pragma mark Startup Timing
+
++ (void)beginRestoringHistoryOfViews
+{
+	/* Counts as a restore in progress so that views which finish
+	 early cannot report all views restored while others are still
+	 being created. */
+	TVCLogControllerHistoryRestoreDidBegin();
+}
+
++ (void)endRestoringHistoryOfViews
+{
+	@synchronized([TVCLogController class]) {
+		_historyRestoresInProgress -= 1;
+
+		TVCLogControllerHistoryRestoreReportIfFinished();
+	}
+}
+
 #pragma mark -
 #pragma mark Initialization
 
@@ -66,6 +180,12 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 {
 	if ((self = [super init])) {
 		self.highlightedLineNumbers	= [NSMutableArray new];
+
+		self.deferredLogLines = [NSMutableArray new];
+
+		self.renderedLineNumbers = [NSMutableArray new];
+		self.deferredLogLinesOverflowed = NO;
+		self.deferredLogLinesRenderPending = NO;
 		
 		self.lastVisitedHighlight = nil;
 		
@@ -377,13 +497,15 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	}
 }
 
-- (void)executeQuickScriptCommand:(NSString *)command withArguments:(NSArray *)args
+- (id)executeQuickScriptCommand:(NSString *)command withArguments:(NSArray *)args
 {
 	WebScriptObject *js_api = [self.webView javaScriptAPI];
 
 	if ( js_api && [js_api isKindOfClass:[WebUndefined class]] == NO) {
-		[js_api callWebScriptMethod:command	withArguments:args];
+		return [js_api callWebScriptMethod:command	withArguments:args];
 	}
+
+	return nil;
 }
 
 - (BOOL)viewHasValidJavaScriptAPIPointer
@@ -586,12 +708,60 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	}
 }
 
+/* Decoding does not touch the view which allows it to be performed
+ while the view is still loading. Lines that fail to decode are dropped. */
+- (NSArray *)decodeOldLines:(NSArray *)oldLines markHistoric:(BOOL)markHistoric onQueue:(dispatch_queue_t)queue
+{
+	NSUInteger oldLinesCount = [oldLines count];
+
+	NSMutableArray *decodedLines = [NSMutableArray arrayWithCapacity:oldLinesCount];
+
+	for (NSUInteger i = 0; i < oldLinesCount; i++) {
+		[decodedLines addObject:[NSNull null]];
+	}
+
+	dispatch_apply(oldLinesCount, queue, ^(size_t i) {
+		TVCLogLine *line = (id)[[TVCLogLine alloc] initWithRawJSONData:oldLines[i]];
+
+		PointerIsEmptyAssert(line);
+
+		if (markHistoric) {
+			[line setIsHistoric:YES];
+		}
+
+		@synchronized(decodedLines) {
+			decodedLines[i] = line;
+		}
+	});
+
+	[decodedLines removeObjectIdenticalTo:[NSNull null]];
+
+	return decodedLines;
+}
+
 /* reloadOldLines: is supposed to be called from inside a queue. */
 - (void)reloadOldLines:(BOOL)markHistoric withOldLines:(NSArray *)oldLines
+{
+	[self reloadOldLines:markHistoric withOldLines:oldLines postPluginEvents:YES];
+}
+
+- (void)reloadOldLines:(BOOL)markHistoric withOldLines:(NSArray *)oldLines postPluginEvents:(BOOL)postPluginEvents
 {
 	/* What lines are we reloading? */
 	NSObjectIsEmptyAssert(oldLines);
 
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+	NSArray *logLines = [self decodeOldLines:oldLines markHistoric:markHistoric onQueue:queue];
+
+	[self reloadOldLines:markHistoric withLogLines:logLines onQueue:queue postPluginEvents:postPluginEvents];
+}
+
+- (void)reloadOldLines:(BOOL)markHistoric withLogLines:(NSArray *)logLines onQueue:(dispatch_queue_t)queue postPluginEvents:(BOOL)postPluginEvents
+{
+	/* What lines are we reloading? */
+	NSObjectIsEmptyAssert(logLines);
+
 	/* Misc. data. */
 	NSMutableArray *lineNumbers = [NSMutableArray array];
 
@@ -599,22 +769,44 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 
 	NSMutableData *newHistoricArchive = [NSMutableData data];
 
-	/* Begin processing. */
-	for (NSData *chunkedData in oldLines) {
-		TVCLogLine *line = (id)[[TVCLogLine alloc] initWithRawJSONData:chunkedData];
+	/* Lines are rendered in parallel. Each result is stored at the index
+	 of its line so that the view can be assembled in the original order. */
+	NSUInteger logLinesCount = [logLines count];
 
-		PointerIsEmptyAssertLoopContinue(line);
+	NSMutableArray *renderedLines = [NSMutableArray arrayWithCapacity:logLinesCount];
 
-		if (markHistoric) {
-			[line setIsHistoric:YES];
-		}
+	for (NSUInteger i = 0; i < logLinesCount; i++) {
+		[renderedLines addObject:[NSNull null]];
+	}
+
+	dispatch_apply(logLinesCount, queue, ^(size_t i) {
+		TVCLogLine *line = logLines[i];
 
 		/* Render everything. */
 		NSDictionary *resultInfo = nil;
 
 		NSString *html = [self renderLogLine:line resultInfo:&resultInfo];
 
-		NSObjectIsEmptyAssertLoopContinue(html);
+		NSObjectIsEmptyAssert(html);
+
+		PointerIsEmptyAssert(resultInfo);
+
+		@synchronized(renderedLines) {
+			renderedLines[i] = @[line, html, resultInfo];
+		}
+	});
+
+	/* Begin processing. */
+	for (id renderedLine in renderedLines) {
+		if (renderedLine == [NSNull null]) {
+			continue;
+		}
+
+		TVCLogLine *line = renderedLine[0];
+
+		NSString *html = renderedLine[1];
+
+		NSDictionary *resultInfo = renderedLine[2];
 
 		/* Gather result information. */
 		NSString *lineNumber = resultInfo[@"lineNumber"];
@@ -646,6 +838,15 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	[self performBlockOnMainThread:^{
 		[self appendHistoricMessageFragment:patchedAppend toHistoricMessagesDiv:markHistoric];
 
+		/* Old lines are placed above everything already in the view. */
+		NSMutableArray *oldLineNumbers = [NSMutableArray arrayWithCapacity:[lineNumbers count]];
+
+		for (NSArray *lineInfo in lineNumbers) {
+			[oldLineNumbers addObject:lineInfo[0]];
+		}
+
+		[self.renderedLineNumbers insertObjects:oldLineNumbers atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [oldLineNumbers count])]];
+
 		[self mark];
 
 		for (NSArray *lineInfo in lineNumbers) {
@@ -659,7 +860,7 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 			[self executeQuickScriptCommand:@"newMessagePostedToView" withArguments:@[lineNumber]];
 			
 			/* Inform plugins. */
-			if ([sharedPluginManager() supportsFeature:THOPluginItemSupportsNewMessagePostedEvent]) {
+			if (postPluginEvents && [sharedPluginManager() supportsFeature:THOPluginItemSupportsNewMessagePostedEvent]) {
 				NSDictionary *resultInfo = lineInfo[1];
 
 				THOPluginDidPostNewMessageConcreteObject *pluginConcreteObject = resultInfo[@"pluginConcreteObject"];
@@ -673,6 +874,11 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 }
 
 - (void)reloadHistory
+{
+	[self reloadHistoryAndPostPluginEvents:YES];
+}
+
+- (void)reloadHistoryAndPostPluginEvents:(BOOL)postPluginEvents
 {
 	self.historyLoaded = YES;
 
@@ -680,34 +886,72 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	{
 		self.reloadingHistory = YES;
 
+		TVCLogControllerHistoryRestoreDidBegin();
+
+		/* The selected view is restored first. Every other view is rendered
+		 at the default priority and its standalone operation is given a
+		 lower queue priority. Lines printed to the view meanwhile wait
+		 for the operation to finish. See -dependencyOfLastQueueItem: */
+		BOOL isSelectedView = ([mainWindow() selectedViewController] == self);
+
+		dispatch_queue_t queue = nil;
+
+		if (isSelectedView) {
+			queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0);
+		} else {
+			queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+		}
+
+		/* The history is read and reset together when the operation runs so
+		 that nothing written in between is lost. The file is left untouched
+		 when the operation is cancelled because the application is being
+		 terminated, in which case the history must survive. */
 		[[self printingQueue] enqueueMessageBlock:^(id operation) {
 			if ([operation isCancelled] == NO) {
 				NSArray *objects = [self.historicLogFile listEntriesWithFetchLimit:100];
 
+				/* The lines are written back by -reloadOldLines: */
 				[self.historicLogFile resetData];
 
-				[self reloadHistoryCompletionBlock:objects];
+				NSArray *logLines = [self decodeOldLines:objects markHistoric:YES onQueue:queue];
+
+				[self reloadHistoryCompletionBlock:logLines onQueue:queue postPluginEvents:postPluginEvents];
 			} else {
-				[self reloadHistoryCompletionBlock:nil];
+				[self reloadHistoryCompletionBlock:nil onQueue:queue postPluginEvents:postPluginEvents];
 			}
 		 } for:self isStandalone:YES];
 	}
 }
 
-- (void)reloadHistoryCompletionBlock:(NSArray *)objects
+- (void)reloadHistoryCompletionBlock:(NSArray *)logLines onQueue:(dispatch_queue_t)queue postPluginEvents:(BOOL)postPluginEvents
 {
-	[self reloadOldLines:YES withOldLines:objects];
+	[self reloadOldLines:YES withLogLines:logLines onQueue:queue postPluginEvents:postPluginEvents];
 
 	[self performBlockOnMainThread:^{
 		[self moveToBottom];
 
 		[self maybeRedrawFrame];
+
+		TVCLogControllerHistoryRestoreDidEnd(self, [logLines count]);
 	}];
 
 	self.reloadingHistory = NO;
+
+	/* The view may have been selected while its history was being
+	 restored, which is when deferred lines cannot be reloaded. */
+	[self performBlockOnMainThread:^{
+		if ([self viewIsVisible]) {
+			[self renderDeferredLogLines];
+		}
+	}];
 }
 
 - (void)reloadTheme
+{
+	[self reloadThemeAndPostPluginEvents:YES];
+}
+
+- (void)reloadThemeAndPostPluginEvents:(BOOL)postPluginEvents
 {
 	if (self.reloadingHistory == NO) {
 		self.reloadingBacklog = YES;
@@ -722,9 +966,9 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 					
 					[self.historicLogFile resetData];
 					
-					[self reloadThemeCompletionBlock:objects];
+					[self reloadThemeCompletionBlock:objects postPluginEvents:postPluginEvents];
 				} else {
-					[self reloadThemeCompletionBlock:nil];
+					[self reloadThemeCompletionBlock:nil postPluginEvents:postPluginEvents];
 				}
 			} for:self isStandalone:YES];
 		}
@@ -735,9 +979,9 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	}
 }
 
-- (void)reloadThemeCompletionBlock:(NSArray *)objects
+- (void)reloadThemeCompletionBlock:(NSArray *)objects postPluginEvents:(BOOL)postPluginEvents
 {
-	[self reloadOldLines:NO withOldLines:objects];
+	[self reloadOldLines:NO withOldLines:objects postPluginEvents:postPluginEvents];
 
 	[self performBlockOnMainThread:^{
 		[self moveToBottom];
@@ -780,6 +1024,14 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 
 - (void)notifyDidBecomeVisible /* When the view is switched to. */
 {
+	if ([mainWindow() selectedViewController] == self) {
+		TVCLogControllerSetVisibleViewController(self);
+	}
+
+	[[self printingQueue] prioritizeOperationsForViewController:self];
+
+	[self renderDeferredLogLines];
+
 	[self executeQuickScriptCommand:@"notifyDidBecomeVisible" withArguments:@[]];
 
 	[self maybeRedrawFrame];
@@ -895,53 +1147,47 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 {
 	self.needsLimitNumberOfLines = NO;
 
-	NSInteger n = (self.activeLineCount - self.maximumLineCount);
-
-	if (self.isLoaded == NO || n <= 0 || self.activeLineCount <= 0) {
+	if (self.isLoaded == NO || self.maximumLineCount <= 0) {
 		return;
 	}
 
-	DOMDocument *doc = [self mainFrameDocument];
-	PointerIsEmptyAssert(doc);
+	NSInteger n = ([self.renderedLineNumbers count] - self.maximumLineCount);
 
-	DOMElement *body = [self documentBody];
-	PointerIsEmptyAssert(body);
+	if (n <= 0) {
+		return;
+	}
+
+	/* Lines are tracked in the order they appear so the oldest can be
+	 removed by naming the first and last of them in a single call. */
+	NSRange prunedRange = NSMakeRange(0, n);
 
-	DOMNodeList *nodeList = [body childNodes];
-	PointerIsEmptyAssert(nodeList);
+	NSArray *prunedLineNumbers = [self.renderedLineNumbers subarrayWithRange:prunedRange];
 
-	n = (nodeList.length - self.maximumLineCount);
+	id removedLines = [self executeQuickScriptCommand:@"removeLinesFromView" withArguments:@[prunedLineNumbers[0], [prunedLineNumbers lastObject]]];
 
-	/* Remove old lines. */
-	for (NSInteger i = (n - 1); i >= 0; --i) {
-		[body removeChild:[nodeList item:(unsigned)i]];
+	if ([removedLines isKindOfClass:[NSNumber class]] == NO || [removedLines boolValue] == NO) {
+		/* The last line is no longer in the view, which is the case when a
+		 style or plugin removed it, so each line is removed on its own. */
+		for (NSString *lineNumber in prunedLineNumbers) {
+			[self executeQuickScriptCommand:@"removeLinesFromView" withArguments:@[lineNumber, lineNumber]];
+		}
 	}
 
-	self.activeLineCount -= n;
+	[self.renderedLineNumbers removeObjectsInRange:prunedRange];
 
-	if (self.activeLineCount < 0) {
-		self.activeLineCount = 0;
-	}
+	self.activeLineCount = [self.renderedLineNumbers count];
 
 	/* Update highlight index. */
 	@synchronized(self.highlightedLineNumbers) {
 		NSObjectIsEmptyAssert(self.highlightedLineNumbers);
 
-		NSMutableArray *newList = [NSMutableArray array];
+		NSSet *prunedLineNumbersSet = [NSSet setWithArray:prunedLineNumbers];
 
-		for (NSString *lineNumber in self.highlightedLineNumbers) {
-			NSString *lid = [NSString stringWithFormat:@"line-%@", lineNumber];
-
-			DOMElement *e = [doc getElementById:lid];
-
-			/* If the element does not exist, then it means
-			 that we removed it up above. */
-			if (e) {
-				[newList addObject:lineNumber];
-			}
-		}
+		NSIndexSet *prunedHighlights = [self.highlightedLineNumbers indexesOfObjectsPassingTest:^BOOL(id obj, NSUInteger idx, BOOL *stop) {
+			return [prunedLineNumbersSet containsObject:obj];
+		}];
 
-		self.highlightedLineNumbers = [newList mutableCopy];
+		[self.highlightedLineNumbers removeObjectsAtIndexes:prunedHighlights];
 	}
 }
 
@@ -968,7 +1214,16 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 		@synchronized(self.highlightedLineNumbers) {
 			[self.highlightedLineNumbers removeAllObjects];
 		}
+
+		/* Deferred lines are in the historic log which is what
+		 the view is reloaded from when it is not being reset. */
+		[self.deferredLogLines removeAllObjects];
+
+		self.deferredLogLinesOverflowed = NO;
+		self.deferredLogLinesRenderPending = NO;
 		
+		[self.renderedLineNumbers removeAllObjects];
+
 		self.activeLineCount = 0;
 		self.lastVisitedHighlight = nil;
 
@@ -1027,7 +1282,255 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	[self print:logLine completionBlock:NULL];
 }
 
+- (BOOL)viewIsVisible
+{
+	/* Safe to call from any thread. */
+	return (TVCLogControllerVisibleViewController() == self);
+}
+
+- (BOOL)deferRenderingOfLogLine
+{
+	/* Views that are not loaded or are encrypted are not deferred. The former
+	 is still loading its history and the latter has no historic log to 
+	 reload from if too many lines arrive while it is hidden. */
+	if ([TPCPreferences deferRenderingInHiddenViews] == NO) {
+		return NO;
+	}
+
+	if (self.isLoaded == NO || self.viewIsEncrypted || self.reloadingBacklog || self.reloadingHistory) {
+		return NO;
+	}
+
+	return ([self viewIsVisible] == NO);
+}
+
 - (void)print:(TVCLogLine *)logLine completionBlock:(void(^)(BOOL highlighted))completionBlock
+{
+	if ([self deferRenderingOfLogLine]) {
+		[self deferPrint:logLine completionBlock:completionBlock];
+	} else {
+		[self printImmediately:logLine completionBlock:completionBlock];
+	}
+}
+
+- (void)deferPrint:(TVCLogLine *)logLine completionBlock:(void(^)(BOOL highlighted))completionBlock
+{
+	/* The line is rendered the same as it would be for a visible view since that
+	 is needed to know whether it is a highlight and who was mentioned in it.
+	 Everything else happens now too. Only the line itself is kept until the
+	 view is selected, at which point it is rendered again and appended. */
+	TVCLogControllerOperationBlock deferBlock = ^(id operation) {
+		NSAssertReturn([operation isCancelled] == NO);
+
+		NSDictionary *resultInfo = nil;
+
+		NSString *html = [self renderLogLine:logLine resultInfo:&resultInfo];
+
+		NSObjectIsEmptyAssert(html);
+
+		BOOL highlighted = [resultInfo boolForKey:TVCLogRendererResultsKeywordMatchFoundAttribute];
+
+		NSArray *mentionedUsers = [resultInfo arrayForKey:TVCLogRendererResultsListOfUsersFoundAttribute];
+
+		[self performBlockOnMainThread:^{
+			/* Plugins are informed of the line when it is received, not when it is shown. */
+			if ([sharedPluginManager() supportsFeature:THOPluginItemSupportsNewMessagePostedEvent]) {
+				[sharedPluginManager() postNewMessageEventForViewController:self withObject:resultInfo[@"pluginConcreteObject"]];
+			}
+
+			if ([self viewIsVisible] && [self.deferredLogLines count] == 0 && self.deferredLogLinesOverflowed == NO) {
+				/* The view was selected while the line was being processed. */
+				[self appendRenderedLogLine:html resultInfo:resultInfo postPluginEvent:NO];
+			} else {
+				/* Lines deferred earlier have to be appended first. */
+				[self addDeferredLogLine:logLine];
+
+				if ([self viewIsVisible]) {
+					[self renderDeferredLogLines];
+				}
+			}
+
+			if (highlighted) {
+				[self.associatedClient cacheHighlightInChannel:self.associatedChannel withLogLine:logLine];
+			}
+
+			[self.historicLogFile writeNewEntryForLogLine:logLine];
+
+			if ([logLine memberType] == TVCLogLineMemberLocalUserType) {
+				[mentionedUsers makeObjectsPerformSelector:@selector(outgoingConversation)];
+			} else {
+				[mentionedUsers makeObjectsPerformSelector:@selector(conversation)];
+			}
+
+			PointerIsEmptyAssert(completionBlock);
+
+			completionBlock(highlighted);
+		}];
+	};
+
+	[[self printingQueue] enqueueMessageBlock:deferBlock for:self];
+}
+
+/* Performed on the main thread. */
+- (void)addDeferredLogLine:(TVCLogLine *)logLine
+{
+	/* Once more lines have arrived than are kept, the view is reloaded from
+	 the historic log when it is selected so none of them are needed. */
+	if (self.deferredLogLinesOverflowed) {
+		return;
+	}
+
+	if ([self.deferredLogLines count] == _deferredLogLinesMaximumCount) {
+		[self.deferredLogLines removeAllObjects];
+
+		self.deferredLogLinesOverflowed = YES;
+
+		return;
+	}
+
+	[self.deferredLogLines addObject:logLine];
+}
+
+/* Performed on the main thread. */
+- (void)renderDeferredLogLines
+{
+	if (self.deferredLogLinesOverflowed) {
+		/* More lines arrived than were kept. Everything that was dropped
+		 is in the historic log so reload from there. Plugins were told
+		 about these lines when they arrived so they are not told again.
+		 A reload is not possible while history is being restored. It
+		 is tried again once restoring history has finished. */
+		if (self.reloadingHistory) {
+			return;
+		}
+
+		[self clearWithReset:NO];
+
+		[self reloadHistoryAndPostPluginEvents:NO];
+
+		return;
+	}
+
+	NSObjectIsEmptyAssert(self.deferredLogLines);
+
+	/* Lines deferred after the operation below is enqueued but before it
+	 runs are picked up by it. Lines printed after it wait for it. */
+	NSAssertReturn(self.deferredLogLinesRenderPending == NO);
+
+	self.deferredLogLinesRenderPending = YES;
+
+	TVCLogControllerOperationBlock renderBlock = ^(id operation) {
+		__block NSArray *logLines = nil;
+
+		[self performBlockOnMainThread:^{
+			logLines = [self.deferredLogLines copy];
+
+			[self.deferredLogLines removeAllObjects];
+
+			self.deferredLogLinesRenderPending = NO;
+		}];
+
+		NSAssertReturn([operation isCancelled] == NO);
+
+		NSObjectIsEmptyAssert(logLines);
+
+		/* Lines are rendered in parallel. Each result is stored at the index
+		 of its line so that they can be appended in the original order. */
+		NSUInteger logLinesCount = [logLines count];
+
+		NSMutableArray *renderedLines = [NSMutableArray arrayWithCapacity:logLinesCount];
+
+		for (NSUInteger i = 0; i < logLinesCount; i++) {
+			[renderedLines addObject:[NSNull null]];
+		}
+
+		dispatch_apply(logLinesCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t i) {
+			NSDictionary *resultInfo = nil;
+
+			NSString *html = [self renderLogLine:logLines[i] resultInfo:&resultInfo];
+
+			NSObjectIsEmptyAssert(html);
+
+			PointerIsEmptyAssert(resultInfo);
+
+			@synchronized(renderedLines) {
+				renderedLines[i] = @[html, resultInfo];
+			}
+		});
+
+		[self performBlockOnMainThread:^{
+			for (id renderedLine in renderedLines) {
+				if (renderedLine == [NSNull null]) {
+					continue;
+				}
+
+				[self appendRenderedLogLine:renderedLine[0] resultInfo:renderedLine[1] postPluginEvent:NO];
+			}
+
+			[self maybeRedrawFrame];
+		}];
+	};
+
+	[[self printingQueue] enqueueMessageBlock:renderBlock for:self];
+}
+
+/* Performed on the main thread. Lines that were deferred were already
+ posted to plugins at the time they were received. */
+- (void)appendRenderedLogLine:(NSString *)html resultInfo:(NSDictionary *)resultInfo postPluginEvent:(BOOL)postPluginEvent
+{
+	/* Increment by one. */
+	self.activeLineCount += 1;
+
+	/* Gather result information. */
+	BOOL highlighted = [resultInfo boolForKey:TVCLogRendererResultsKeywordMatchFoundAttribute];
+
+	NSString *lineNumber = resultInfo[@"lineNumber"];
+
+	NSDictionary *inlineImageMatches = [resultInfo dictionaryForKey:@"InlineImagesToValidate"];
+
+	/* Record highlights. */
+	if (highlighted) {
+		@synchronized(self.highlightedLineNumbers) {
+			[self.highlightedLineNumbers addObject:lineNumber];
+		}
+	}
+
+	/* Do the actual append to WebKit. */
+	[self appendToDocumentBody:html];
+
+	[self.renderedLineNumbers addObject:lineNumber];
+
+	/* Inform the style of the new append. */
+	[self executeQuickScriptCommand:@"newMessagePostedToView" withArguments:@[lineNumber]];
+
+	/* Inform plugins. */
+	if (postPluginEvent && [sharedPluginManager() supportsFeature:THOPluginItemSupportsNewMessagePostedEvent]) {
+		[sharedPluginManager() postNewMessageEventForViewController:self withObject:resultInfo[@"pluginConcreteObject"]];
+	}
+
+	/* Limit lines. */
+	if (self.maximumLineCount > 0 && (self.activeLineCount - 10) > self.maximumLineCount) {
+		/* Only cut lines if our number is divisible by 5. This makes it so every
+		 line is not using resources. */
+
+		if ((self.activeLineCount % 5) == 0) {
+			[self setNeedsLimitNumberOfLines];
+		}
+	}
+
+	/* Begin processing inline images. */
+	/* We go through the inline image list here and pass to the loader now so that
+	 we know the links have hit the webview before we even try loading them. */
+	for (NSString *uniqueKey in inlineImageMatches) {
+		TVCImageURLoader *loader = [TVCImageURLoader new];
+
+		[loader setDelegate:self];
+
+		[loader assesURL:inlineImageMatches[uniqueKey] withID:uniqueKey];
+	}
+}
+
+- (void)printImmediately:(TVCLogLine *)logLine completionBlock:(void(^)(BOOL highlighted))completionBlock
 {
 	/* Continue with a normal print job. */
 	TVCLogControllerOperationBlock printBlock = ^(id operation) {
@@ -1039,61 +1542,18 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 		NSString *html = [self renderLogLine:logLine resultInfo:&resultInfo];
 
 		if (html) {
-			/* Increment by one. */
-			self.activeLineCount += 1;
-
 			/* Gather result information. */
 			BOOL highlighted = [resultInfo boolForKey:TVCLogRendererResultsKeywordMatchFoundAttribute];
 
-			NSString *lineNumber = resultInfo[@"lineNumber"];
-		  //NSString *renderTime = [resultInfo objectForKey:@"lineRenderTime"];
-
 			NSArray *mentionedUsers = [resultInfo arrayForKey:TVCLogRendererResultsListOfUsersFoundAttribute];
 
-			NSDictionary *inlineImageMatches = [resultInfo dictionaryForKey:@"InlineImagesToValidate"];
-			
 			[self performBlockOnMainThread:^{
-				/* Record highlights. */
-				if (highlighted) {
-					@synchronized(self.highlightedLineNumbers) {
-						[self.highlightedLineNumbers addObject:lineNumber];
-					}
+				[self appendRenderedLogLine:html resultInfo:resultInfo postPluginEvent:YES];
 
+				if (highlighted) {
 					[self.associatedClient cacheHighlightInChannel:self.associatedChannel withLogLine:logLine];
 				}
 
-				/* Do the actual append to WebKit. */
-				[self appendToDocumentBody:html];
-
-				/* Inform the style of the new append. */
-				[self executeQuickScriptCommand:@"newMessagePostedToView" withArguments:@[lineNumber]];
-				
-				/* Inform plugins. */
-				if ([sharedPluginManager() supportsFeature:THOPluginItemSupportsNewMessagePostedEvent]) {
-					[sharedPluginManager() postNewMessageEventForViewController:self withObject:resultInfo[@"pluginConcreteObject"]];
-				}
-
-				/* Limit lines. */
-				if (self.maximumLineCount > 0 && (self.activeLineCount - 10) > self.maximumLineCount) {
-					/* Only cut lines if our number is divisible by 5. This makes it so every
-					 line is not using resources. */
-					
-					if ((self.activeLineCount % 5) == 0) {
-						[self setNeedsLimitNumberOfLines];
-					}
-				}
-
-				/* Begin processing inline images. */
-				/* We go through the inline image list here and pass to the loader now so that
-				 we know the links have hit the webview before we even try loading them. */
-				for (NSString *uniqueKey in inlineImageMatches) {
-					TVCImageURLoader *loader = [TVCImageURLoader new];
-
-					[loader setDelegate:self];
-
-					[loader assesURL:inlineImageMatches[uniqueKey] withID:uniqueKey];
-				}
-				
 				/* Log this log line. */
 				/* If the channel is encrypted, then we refuse to write to
 				 the actual historic log so there is no trace of the chatter
@@ -1127,6 +1587,23 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	[[self printingQueue] enqueueMessageBlock:printBlock for:self];
 }
 
+- (NSDictionary *)rendererAttributesForLogLine:(TVCLogLine *)line
+{
+	BOOL drawLinks = ([[TLOLinkParser bannedLineTypes] containsObject:[line lineTypeString]] == NO);
+
+	NSMutableDictionary *rendererAttributes = [NSMutableDictionary dictionary];
+
+	[rendererAttributes maybeSetObject:[line highlightKeywords] forKey:TVCLogRendererConfigurationHighlightKeywordsAttribute];
+	[rendererAttributes maybeSetObject:[line excludeKeywords] forKey:TVCLogRendererConfigurationExcludedKeywordsAttribute];
+	
+	[rendererAttributes setBool:drawLinks forKey:TVCLogRendererConfigurationShouldRenderLinksAttribute];
+
+	[rendererAttributes setInteger:[line lineType] forKey:TVCLogRendererConfigurationLineTypeAttribute];
+	[rendererAttributes setInteger:[line memberType] forKey:TVCLogRendererConfigurationMemberTypeAttribute];
+
+	return rendererAttributes;
+}
+
 - (NSString *)renderLogLine:(TVCLogLine *)line resultInfo:(NSDictionary * __autoreleasing *)resultInfo
 {
 	NSObjectIsEmptyAssertReturn([line messageBody], nil);
@@ -1140,25 +1617,13 @@ NSString * const TVCLogControllerViewFinishedLoadingNotification = @"TVCLogContr
 	NSString *renderedBody = nil;
 	NSString *lineTypeStng = [line lineTypeString];
 
-	BOOL drawLinks = ([[TLOLinkParser bannedLineTypes] containsObject:lineTypeStng] == NO);
-
 	// ---- //
 
-	NSMutableDictionary *rendererAttributes = [NSMutableDictionary dictionary];
-
 	NSDictionary *rendererResults = nil;
 
-	[rendererAttributes maybeSetObject:[line highlightKeywords] forKey:TVCLogRendererConfigurationHighlightKeywordsAttribute];
-	[rendererAttributes maybeSetObject:[line excludeKeywords] forKey:TVCLogRendererConfigurationExcludedKeywordsAttribute];
-	
-	[rendererAttributes setBool:drawLinks forKey:TVCLogRendererConfigurationShouldRenderLinksAttribute];
-
-	[rendererAttributes setInteger:[line lineType] forKey:TVCLogRendererConfigurationLineTypeAttribute];
-	[rendererAttributes setInteger:[line memberType] forKey:TVCLogRendererConfigurationMemberTypeAttribute];
-
 	renderedBody = [TVCLogRenderer renderBody:[line messageBody]
 								forController:self
-							   withAttributes:rendererAttributes
+							   withAttributes:[self rendererAttributesForLogLine:line]
 								   resultInfo:&rendererResults];
 
 	if (renderedBody == nil) {
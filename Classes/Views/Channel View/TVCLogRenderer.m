@@ -38,11 +38,41 @@
 
 #import "TextualApplication.h"
 
+#import "TVCLogRendererEscaping.h"
+
+#import <pthread.h>
+
 typedef uint32_t attr_t;
 
+/* Values read out of the renderer attributes dictionary once when it is
+ set so that each pass does not have to perform its own lookups. */
+typedef struct {
+	TVCLogLineType lineType;
+	TVCLogLineMemberType memberType;
+	BOOL renderLinks;
+} TVCLogRendererOptions;
+
+/* Buffers that are kept around for the lifetime of a thread so that each
+ message rendered does not need to allocate its own. A renderer that starts
+ while the storage of its thread is already in use allocates its own. */
+typedef struct {
+	attr_t *attributes;
+	NSUInteger attributesCapacity;
+	NSRange *ranges;
+	NSUInteger rangesCapacity;
+	UniChar *characters;
+	NSUInteger charactersCapacity;
+	CFMutableSetRef matchedLinks;
+	BOOL inUse;
+} TVCLogRendererScratchStorage;
+
 @interface TVCLogRenderer ()
 {
 	void *_effectAttributes;
+
+	TVCLogRendererOptions _options;
+
+	TVCLogRendererScratchStorage *_scratchStorage;
 }
 
 @property (nonatomic, copy) NSString *body;
@@ -123,6 +153,224 @@ static void setFlag(attr_t *attrBuf, attr_t flag, NSInteger start, NSInteger len
 	}
 }
 
+#define _unicodeSpamNormalCharacter				0
+#define _unicodeSpamCombiningCharacter			1
+#define _unicodeSpamDirectionalControlCharacter		2
+
+static uint8_t unicodeSpamCharacterClass(UniChar c)
+{
+	/* Only a handful of pages in the BMP contain characters that we filter.
+	 The page table lets every other character be classified with one lookup. */
+	static const uint8_t pageTable[256] = {
+		[0x03] = 1, [0x1A] = 1, [0x1D] = 1, [0x20] = 1, [0xFE] = 1
+	};
+
+	if (pageTable[(c >> 8)] == 0) {
+		return _unicodeSpamNormalCharacter;
+	}
+
+	if ((c >= 0x0300 && c <= 0x036F) ||		// Combining Diacritical Marks
+		(c >= 0x1AB0 && c <= 0x1AFF) ||		// Combining Diacritical Marks Extended
+		(c >= 0x1DC0 && c <= 0x1DFF) ||		// Combining Diacritical Marks Supplement
+		(c >= 0x20D0 && c <= 0x20FF) ||		// Combining Diacritical Marks for Symbols
+		(c >= 0xFE20 && c <= 0xFE2F))		// Combining Half Marks
+	{
+		return _unicodeSpamCombiningCharacter;
+	}
+
+	if ((c >= 0x202A && c <= 0x202E) ||		// Directional embeddings, overrides, and pop
+		(c >= 0x2066 && c <= 0x2069))		// Directional isolates and pop
+	{
+		return _unicodeSpamDirectionalControlCharacter;
+	}
+
+	return _unicodeSpamNormalCharacter;
+}
+
+static NSString *stripUnicodeSpamFromString(NSString *body, attr_t *attrBuf, NSUInteger maximumCombiningCharacters)
+{
+	/* Directional embeddings, overrides, and isolates are removed. Runs of
+	 combining characters longer than maximumCombiningCharacters are truncated
+	 and what was removed is represented by a single replacement character.
+	 The attribute buffer is compacted in step so that it continues to match
+	 the returned string. nil is returned when there was nothing to filter. */
+	CFStringRef bodyRef = (__bridge CFStringRef)body;
+
+	CFIndex bodyLength = CFStringGetLength(bodyRef);
+
+	CFStringInlineBuffer bodyBuffer;
+
+	CFStringInitInlineBuffer(bodyRef, &bodyBuffer, CFRangeMake(0, bodyLength));
+
+	UniChar *dest = NULL;
+
+	CFIndex n = 0;
+
+	NSUInteger combiningCharacterCount = 0;
+
+	for (CFIndex i = 0; i < bodyLength; i++) {
+		UniChar c = CFStringGetCharacterFromInlineBuffer(&bodyBuffer, i);
+
+		uint8_t characterClass = unicodeSpamCharacterClass(c);
+
+		BOOL dropCharacter = NO;
+		BOOL replaceCharacter = NO;
+
+		if (characterClass == _unicodeSpamCombiningCharacter) {
+			combiningCharacterCount += 1;
+
+			if (combiningCharacterCount > maximumCombiningCharacters) {
+				if (combiningCharacterCount == (maximumCombiningCharacters + 1)) {
+					replaceCharacter = YES;
+				} else {
+					dropCharacter = YES;
+				}
+			}
+		} else {
+			combiningCharacterCount = 0;
+
+			if (characterClass == _unicodeSpamDirectionalControlCharacter) {
+				dropCharacter = YES;
+			}
+		}
+
+		/* Nothing is allocated until the first change is made. Everything before
+		 that point is copied over in one go. */
+		if (dest == NULL) {
+			if (dropCharacter == NO && replaceCharacter == NO) {
+				n += 1;
+
+				continue;
+			}
+
+			dest = malloc(sizeof(UniChar) * bodyLength);
+
+			CFStringGetCharacters(bodyRef, CFRangeMake(0, n), dest);
+		}
+
+		if (dropCharacter) {
+			continue;
+		}
+
+		if (attrBuf) {
+			attrBuf[n] = attrBuf[i];
+		}
+
+		if (replaceCharacter) {
+			dest[n++] = 0xfffd;
+		} else {
+			dest[n++] = c;
+		}
+	}
+
+	if (dest == NULL) {
+		return nil;
+	}
+
+	NSString *fixedString = [[NSString alloc] initWithCharactersNoCopy:dest length:n freeWhenDone:YES];
+
+	return fixedString;
+}
+
+#define _escapeStringStackBufferLength		512
+
+static pthread_key_t _scratchStorageThreadKey;
+
+static void freeScratchStorage(void *value)
+{
+	TVCLogRendererScratchStorage *storage = value;
+
+	if (storage->attributes) {
+		free(storage->attributes);
+	}
+
+	if (storage->ranges) {
+		free(storage->ranges);
+	}
+
+	if (storage->characters) {
+		free(storage->characters);
+	}
+
+	if (storage->matchedLinks) {
+		CFRelease(storage->matchedLinks);
+	}
+
+	free(storage);
+}
+
+static TVCLogRendererScratchStorage *acquireScratchStorage(void)
+{
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		pthread_key_create(&_scratchStorageThreadKey, freeScratchStorage);
+	});
+
+	TVCLogRendererScratchStorage *storage = pthread_getspecific(_scratchStorageThreadKey);
+
+	if (storage == NULL) {
+		storage = calloc(1, sizeof(TVCLogRendererScratchStorage));
+
+		pthread_setspecific(_scratchStorageThreadKey, storage);
+	} else if (storage->inUse) {
+		return NULL;
+	}
+
+	storage->inUse = YES;
+
+	return storage;
+}
+
+static void relinquishScratchStorage(TVCLogRendererScratchStorage *storage)
+{
+	storage->inUse = NO;
+}
+
+static attr_t *scratchStorageAttributesWithCapacity(TVCLogRendererScratchStorage *storage, NSUInteger capacity)
+{
+	if (storage->attributesCapacity < capacity) {
+		storage->attributes = reallocf(storage->attributes, (sizeof(attr_t) * capacity));
+
+		storage->attributesCapacity = capacity;
+	}
+
+	return storage->attributes;
+}
+
+static NSRange *scratchStorageRangesWithCapacity(TVCLogRendererScratchStorage *storage, NSUInteger capacity)
+{
+	if (storage->rangesCapacity < capacity) {
+		storage->ranges = reallocf(storage->ranges, (sizeof(NSRange) * capacity));
+
+		storage->rangesCapacity = capacity;
+	}
+
+	return storage->ranges;
+}
+
+static UniChar *scratchStorageCharactersWithCapacity(TVCLogRendererScratchStorage *storage, NSUInteger capacity)
+{
+	if (storage->charactersCapacity < capacity) {
+		storage->characters = reallocf(storage->characters, (sizeof(UniChar) * capacity));
+
+		storage->charactersCapacity = capacity;
+	}
+
+	return storage->characters;
+}
+
+/* The set is empty when it is returned. Whoever uses it empties it again
+ when done so that it does not keep the strings it was given alive. */
+static CFMutableSetRef scratchStorageMatchedLinks(TVCLogRendererScratchStorage *storage)
+{
+	if (storage->matchedLinks == NULL) {
+		storage->matchedLinks = CFSetCreateMutable(kCFAllocatorDefault, 0, &kCFTypeSetCallBacks);
+	}
+
+	return storage->matchedLinks;
+}
+
 static BOOL isClear(attr_t *attrBuf, attr_t flag, NSInteger start, NSInteger len)
 {
 	attr_t *target = (attrBuf + start);
@@ -175,20 +423,34 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 
 	NSInteger n	= 0;
 
-	attr_t attrBuf[length];
-	attr_t currentAttr = 0;
+	/* The attribute buffer is written to in place. Whatever owns it is
+	 released by -cleanUpResources once rendering has finished. */
+	_scratchStorage = acquireScratchStorage();
 
-	memset(attrBuf, 0, (length * sizeof(attr_t)));
+	attr_t *attrBuf = NULL;
 
-	UniChar dest[length];
-	UniChar source[length];
+	UniChar *characters = NULL;
 
-	for (NSInteger i = 0; i < length; i++) {
-		source[i] = [_body characterAtIndex:i];
+	if (_scratchStorage) {
+		attrBuf = scratchStorageAttributesWithCapacity(_scratchStorage, MAX(length, 1));
+
+		characters = scratchStorageCharactersWithCapacity(_scratchStorage, MAX(length, 1));
+	} else {
+		attrBuf = malloc(sizeof(attr_t) * MAX(length, 1));
+
+		characters = malloc(sizeof(UniChar) * MAX(length, 1));
 	}
 
+	attr_t currentAttr = 0;
+
+	memset(attrBuf, 0, (length * sizeof(attr_t)));
+
+	CFStringGetCharacters((__bridge CFStringRef)_body, CFRangeMake(0, length), characters);
+
+	/* Characters that are kept are compacted in place. This is safe because
+	 a character is never written ahead of the one being read. */
 	for (NSInteger i = 0; i < length; i++) {
-		UniChar c = source[i];
+		UniChar c = characters[i];
 
 		if (c < 0x20) {
 			switch (c) {
@@ -208,7 +470,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 					NSInteger backgroundColor = -1;
 
 					if ((i + 1) < length) {
-						c = source[(i + 1)];
+						c = characters[(i + 1)];
 
 						if (CSCEF_StringIsBase10Numeric(c)) {
 							++i;
@@ -216,7 +478,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 							foregoundColor = (c - '0');
 
 							if ((i + 1) < length) {
-								c = source[(i + 1)];
+								c = characters[(i + 1)];
 
 								if (CSCEF_StringIsBase10Numeric(c)) {
 									++i;
@@ -225,7 +487,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 								}
 
 								if ((i + 1) < length) {
-									c = source[(i + 1)];
+									c = characters[(i + 1)];
 								}
 							}
 
@@ -236,7 +498,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 								++i;
 
 								if ((i + 1) < length) {
-									c = source[(i + 1)];
+									c = characters[(i + 1)];
 
 									if (CSCEF_StringIsBase10Numeric(c)) {
 										++i;
@@ -244,7 +506,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 										backgroundColor = (c - '0');
 
 										if ((i + 1) < length) {
-											c = source[(i + 1)];
+											c = characters[(i + 1)];
 
 											if (CSCEF_StringIsBase10Numeric(c)) {
 												++i;
@@ -324,39 +586,49 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 		
 		attrBuf[n] = currentAttr;
 		
-		dest[n++] = c;
+		characters[n++] = c;
 	}
 
-	NSString *stringBody = [NSString stringWithCharacters:dest length:n];
+	NSString *stringBody = [NSString stringWithCharacters:characters length:n];
+
+	if (_scratchStorage == NULL) {
+		free(characters);
+	}
 
 	_body = [stringBody copy];
 
 	_outputDictionary[TVCLogRendererResultsOriginalBodyWithoutEffectsAttribute] = stringBody;
 
-	NSInteger bufferSize = sizeof(attrBuf);
+	_effectAttributes = attrBuf;
+}
 
-	_effectAttributes = malloc(bufferSize);
+- (void)setRendererAttributes:(NSDictionary *)rendererAttributes
+{
+	_rendererAttributes = [rendererAttributes copy];
+
+	_options.lineType = [_rendererAttributes integerForKey:TVCLogRendererConfigurationLineTypeAttribute];
+	_options.memberType = [_rendererAttributes integerForKey:TVCLogRendererConfigurationMemberTypeAttribute];
 
-	memcpy(_effectAttributes, attrBuf, bufferSize);
+	_options.renderLinks = [_rendererAttributes boolForKey:TVCLogRendererConfigurationShouldRenderLinksAttribute];
 }
 
 - (BOOL)isRenderingPRIVMSG
 {
-	TVCLogLineType lineType = [_rendererAttributes integerForKey:TVCLogRendererConfigurationLineTypeAttribute];
+	TVCLogLineType lineType = _options.lineType;
 
 	return (lineType == TVCLogLinePrivateMessageType || lineType == TVCLogLineActionType);
 }
 
 - (BOOL)isRenderingPRIVMSG_or_NOTICE
 {
-	TVCLogLineType lineType = [_rendererAttributes integerForKey:TVCLogRendererConfigurationLineTypeAttribute];
+	TVCLogLineType lineType = _options.lineType;
 
 	return (lineType == TVCLogLinePrivateMessageType || lineType == TVCLogLineActionType || lineType == TVCLogLineNoticeType);
 }
 
 - (BOOL)scanForKeywords
 {
-	TVCLogLineMemberType memberType = [_rendererAttributes integerForKey:TVCLogRendererConfigurationMemberTypeAttribute];
+	TVCLogLineMemberType memberType = _options.memberType;
 
 	return ([self isRenderingPRIVMSG] || memberType == TVCLogLineMemberNormalType);
 }
@@ -364,7 +636,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 - (void)stripDangerousUnicodeCharactersFromBody
 {
 	if ([TPCPreferences automaticallyFilterUnicodeTextSpam]) {
-		TVCLogLineType lineType = [_rendererAttributes integerForKey:TVCLogRendererConfigurationLineTypeAttribute];
+		TVCLogLineType lineType = _options.lineType;
 
 		if (lineType == TVCLogLineActionType			||
 			lineType == TVCLogLineCTCPType				||
@@ -375,25 +647,35 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 			lineType == TVCLogLinePrivateMessageType	||
 			lineType == TVCLogLineTopicType)
 		{
-			NSString * const replacementCharacter = [NSString stringWithFormat:@"%C", 0xfffd];
+			NSUInteger maximumCombiningCharacters = [TPCPreferences automaticallyFilterUnicodeTextSpamMaximumCombiningCharacters];
 
-			NSString *fixedString = [XRRegularExpression string:_body replacedByRegex:@"\\p{InCombining_Diacritical_Marks}" withString:replacementCharacter];
+			NSString *fixedString = stripUnicodeSpamFromString(_body, _effectAttributes, maximumCombiningCharacters);
 
-			_body = [fixedString copy];
+			if (fixedString) {
+				_body = fixedString;
+			}
 		}
 	}
 }
 
 - (void)buildListOfLinksInBody
 {
-	BOOL renderLinks = [_rendererAttributes boolForKey:TVCLogRendererConfigurationShouldRenderLinksAttribute];
+	if (_options.renderLinks) {
+		NSArray *urlAryRanges = [TLOLinkParser locatedLinksForString:_body];
 
-	if (renderLinks) {
-		NSMutableDictionary *urlAry = [NSMutableDictionary dictionary];
+		_outputDictionary[TVCLogRendererResultsRangesOfAllLinksInBodyAttribute] = urlAryRanges;
 
-		NSMutableArray *matchedEntries = [NSMutableArray array];
+		NSObjectIsEmptyAssert(urlAryRanges);
 
-		NSArray *urlAryRanges = [TLOLinkParser locatedLinksForString:_body];
+		NSMutableDictionary *urlAry = [NSMutableDictionary dictionaryWithCapacity:[urlAryRanges count]];
+
+		CFMutableSetRef matchedEntries = NULL;
+
+		if (_scratchStorage) {
+			matchedEntries = scratchStorageMatchedLinks(_scratchStorage);
+		} else {
+			matchedEntries = CFSetCreateMutable(kCFAllocatorDefault, 0, &kCFTypeSetCallBacks);
+		}
 
 		for (NSArray *rn in urlAryRanges) {
 			NSRange r = NSRangeFromString(rn[0]);
@@ -407,10 +689,10 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 				/* Build unique list of URLs by using them as keys. */
 				NSString *matchedURL = rn[1];
 
-				if ([matchedEntries containsObject:matchedURL] == NO) {
-					[matchedEntries addObject:matchedURL];
+				if (CFSetContainsValue(matchedEntries, (__bridge const void *)matchedURL) == NO) {
+					CFSetAddValue(matchedEntries, (__bridge const void *)matchedURL);
 
-					NSString *hashedValue = [NSString stringWithUUID];
+					NSString *hashedValue = [TLOLinkParser uniqueLinkIdentifier];
 
 					if (urlAry[hashedValue] == nil) {
 						urlAry[hashedValue] = matchedURL;
@@ -419,9 +701,12 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 			}
 		}
 
-		matchedEntries = nil;
+		if (_scratchStorage) {
+			CFSetRemoveAllValues(matchedEntries);
+		} else {
+			CFRelease(matchedEntries);
+		}
 
-		_outputDictionary[TVCLogRendererResultsRangesOfAllLinksInBodyAttribute] = urlAryRanges;
 		_outputDictionary[TVCLogRendererResultsUniqueListOfAllLinksInBodyAttribute] = urlAry;
 	}
 }
@@ -469,7 +754,10 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 			}
 		}
 
-		NSMutableArray *excludeRanges = [NSMutableArray array];
+		NSRange *excludeRanges = NULL;
+
+		NSUInteger excludeRangesCount = 0;
+		NSUInteger excludeRangesCapacity = 0;
 
 		/* Exclude word matching. */
 		NSInteger start = 0;
@@ -485,7 +773,17 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 					break;
 				}
 
-				[excludeRanges addObject:[NSValue valueWithRange:r]];
+				if (excludeRangesCount == excludeRangesCapacity) {
+					excludeRangesCapacity = MAX(8, (excludeRangesCapacity * 2));
+
+					if (_scratchStorage) {
+						excludeRanges = scratchStorageRangesWithCapacity(_scratchStorage, excludeRangesCapacity);
+					} else {
+						excludeRanges = reallocf(excludeRanges, (sizeof(NSRange) * excludeRangesCapacity));
+					}
+				}
+
+				excludeRanges[excludeRangesCount++] = r;
 
 				start = (NSMaxRange(r) + 1);
 			}
@@ -499,23 +797,27 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 			case TXNicknameHighlightExactMatchType:
 			case TXNicknameHighlightPartialMatchType:
 			{
-				foundKeyword = [self matchKeywordsUsingNormalMatching:highlightWords excludedRanges:excludeRanges];
+				foundKeyword = [self matchKeywordsUsingNormalMatching:highlightWords excludedRanges:excludeRanges count:excludeRangesCount];
 
 				break;
 			}
 			case TXNicknameHighlightRegularExpressionMatchType:
 			{
-				foundKeyword = [self matchKeywordsUsingRegularExpression:highlightWords excludedRanges:excludeRanges];
+				foundKeyword = [self matchKeywordsUsingRegularExpression:highlightWords excludedRanges:excludeRanges count:excludeRangesCount];
 
 				break;
 			}
 		}
 
+		if (_scratchStorage == NULL && excludeRanges) {
+			free(excludeRanges);
+		}
+
 		[_outputDictionary setBool:foundKeyword forKey:TVCLogRendererResultsKeywordMatchFoundAttribute];
 	}
 }
 
-- (BOOL)matchKeywordsUsingNormalMatching:(NSArray *)keywrods excludedRanges:(NSArray *)excludedRanges
+- (BOOL)matchKeywordsUsingNormalMatching:(NSArray *)keywrods excludedRanges:(NSRange *)excludedRanges count:(NSUInteger)excludedRangesCount
 {
 	/* Normal keyword matching. Partial and absolute. */
 	BOOL foundKeyword = NO;
@@ -535,8 +837,8 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 
 			BOOL enabled = YES;
 
-			for (NSValue *e in excludedRanges) {
-				if (NSIntersectionRange(r, [e rangeValue]).length > 0) {
+			for (NSUInteger i = 0; i < excludedRangesCount; i++) {
+				if (NSIntersectionRange(r, excludedRanges[i]).length > 0) {
 					enabled = NO;
 
 					break;
@@ -572,7 +874,7 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 	return foundKeyword;
 }
 
-- (BOOL)matchKeywordsUsingRegularExpression:(NSArray *)keywords excludedRanges:(NSArray *)excludedRanges
+- (BOOL)matchKeywordsUsingRegularExpression:(NSArray *)keywords excludedRanges:(NSRange *)excludedRanges count:(NSUInteger)excludedRangesCount
 {
 	/* Regular expression keyword matching. */
 	BOOL foundKeyword = NO;
@@ -585,9 +887,9 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 		} else {
 			BOOL enabled = YES;
 
-			for (NSValue *e in excludedRanges) {
+			for (NSUInteger i = 0; i < excludedRangesCount; i++) {
 				/* Did the regular expression find a match inside an excluded range? */
-				if (NSIntersectionRange(matchRange, [e rangeValue]).length > 0) {
+				if (NSIntersectionRange(matchRange, excludedRanges[i]).length > 0) {
 					enabled = NO;
 
 					break;
@@ -618,42 +920,98 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 - (void)findAllChannelNames
 {
 	if ([self isRenderingPRIVMSG_or_NOTICE]) {
-		NSInteger start = 0;
-		NSInteger length = [_body length];
+		IRCISupportInfo *supportInfo = [[_controller associatedClient] supportInfo];
+
+		CFStringRef bodyRef = (__bridge CFStringRef)_body;
+
+		CFIndex length = CFStringGetLength(bodyRef);
+
+		CFStringInlineBuffer bodyBuffer;
+
+		CFStringInitInlineBuffer(bodyRef, &bodyBuffer, CFRangeMake(0, length));
+
+		/* The CHANTYPES table is copied once so that each character of
+		 the body is tested without sending a message. When there is no
+		 client to ask, # is the only prefix that is recognized. */
+		BOOL channelNamePrefixTable[IRCISupportLookupTableSize];
+
+		if (supportInfo) {
+			[supportInfo getChannelNamePrefixTable:channelNamePrefixTable];
+		} else {
+			memset(channelNamePrefixTable, 0, sizeof(channelNamePrefixTable));
+
+			channelNamePrefixTable['#'] = YES;
+		}
+
+		/* A channel name is a CHANTYPES character followed by one or more
+		 of [a-zA-Z0-9#-]. It cannot touch a word letter on either side. */
+#define _characterIsChannelNamePrefix(c)		((c) < IRCISupportLookupTableSize && channelNamePrefixTable[(c)])
+
+#define _characterIsChannelNameCharacter(c)		((c >= 'a' && c <= 'z') ||		\
+												 (c >= 'A' && c <= 'Z') ||		\
+												 (c >= '0' && c <= '9') ||		\
+												  c == '#' || c == '-')
+
+		CFIndex start = 0;
 
 		while (start < length) {
-			NSRange r = [_body rangeOfNextSegmentMatchingRegularExpression:@"#([a-zA-Z0-9\\#\\-]+)" startingAt:start];
+			UniChar c = CFStringGetCharacterFromInlineBuffer(&bodyBuffer, start);
 
-			if (r.location == NSNotFound) {
-				break;
+			if (_characterIsChannelNamePrefix(c) == NO) {
+				start += 1;
+
+				continue;
 			}
 
-			NSInteger prev = (r.location - 1);
+			CFIndex end = (start + 1);
 
-			if (0 <= prev && prev < length) {
-				UniChar c = [_body characterAtIndex:prev];
+			while (end < length) {
+				UniChar cc = CFStringGetCharacterFromInlineBuffer(&bodyBuffer, end);
 
-				if (CSCEF_StringIsWordLetter(c)) {
+				if (_characterIsChannelNameCharacter(cc) == NO) {
 					break;
 				}
+
+				end += 1;
 			}
 
-			NSInteger next = NSMaxRange(r);
+			NSRange r = NSMakeRange(start, (end - start));
 
-			if (next < length) {
-				UniChar c = [_body characterAtIndex:next];
+			if (r.length < 2) {
+				start += 1;
 
-				if (CSCEF_StringIsWordLetter(c)) {
-					break;
+				continue;
+			}
+
+			BOOL cleanMatch = YES;
+
+			if (start > 0) {
+				UniChar cc = CFStringGetCharacterFromInlineBuffer(&bodyBuffer, (start - 1));
+
+				if (CSCEF_StringIsWordLetter(cc)) {
+					cleanMatch = NO;
 				}
 			}
 
-			if (isClear(_effectAttributes, _rendererURLAttribute, r.location, r.length)) {
-				setFlag(_effectAttributes, _rendererChannelNameAttribute, r.location, r.length);
+			if (cleanMatch && end < length) {
+				UniChar cc = CFStringGetCharacterFromInlineBuffer(&bodyBuffer, end);
+
+				if (CSCEF_StringIsWordLetter(cc)) {
+					cleanMatch = NO;
+				}
 			}
 
-			start = (NSMaxRange(r) + 1);
+			if (cleanMatch) {
+				if (isClear(_effectAttributes, _rendererURLAttribute, r.location, r.length)) {
+					setFlag(_effectAttributes, _rendererChannelNameAttribute, r.location, r.length);
+				}
+			}
+
+			start = (end + 1);
 		}
+
+#undef _characterIsChannelNamePrefix
+#undef _characterIsChannelNameCharacter
 	}
 }
 
@@ -1092,9 +1450,21 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 
 - (void)cleanUpResources
 {
-	if (_effectAttributes) {
+	if (_scratchStorage) {
+		relinquishScratchStorage(_scratchStorage);
+
+		_scratchStorage = NULL;
+	} else if (_effectAttributes) {
 		free(_effectAttributes);
 	}
+
+	_effectAttributes = NULL;
+}
+
+- (void)dealloc
+{
+	/* Rendering can return early when it is cancelled. */
+	[self cleanUpResources];
 }
 
 + (NSString *)renderBody:(NSString *)body forController:(TVCLogController *)controller withAttributes:(NSDictionary *)inputDictionary resultInfo:(NSDictionary *__autoreleasing *)outputDictionary
@@ -1206,6 +1576,15 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 
 + (NSString *)renderTemplate:(NSString *)templateName attributes:(NSDictionary *)templateTokens
 {
+	/* Most templates only substitute values and are rendered from their compiled form. */
+	NSString *compiledHtml = [themeSettings() renderCompiledTemplateWithName:templateName attributes:templateTokens];
+
+	if (compiledHtml) {
+		NSObjectIsEmptyAssertReturn(compiledHtml, nil);
+
+		return compiledHtml;
+	}
+
 	GRMustacheTemplate *tmpl = [themeSettings() templateWithName:templateName];
 
 	PointerIsEmptyAssertReturn(tmpl, nil);
@@ -1219,12 +1598,48 @@ static NSInteger getNextAttributeRange(attr_t *attrBuf, NSInteger start, NSInteg
 
 + (NSString *)escapeString:(NSString *)s
 {
-	s = [s gtm_stringByEscapingForHTML];
+	PointerIsEmptyAssertReturn(s, nil);
+
+	CFStringRef stringRef = (__bridge CFStringRef)s;
+
+	CFIndex length = CFStringGetLength(stringRef);
+
+	if (length == 0) {
+		return s;
+	}
+
+	/* Most strings are short enough to be copied onto the stack. */
+	UniChar stackBuffer[_escapeStringStackBufferLength];
+
+	UniChar *characters = (UniChar *)CFStringGetCharactersPtr(stringRef);
 
-	s = [s stringByReplacingOccurrencesOfString:@"\t" withString:@"&nbsp;&nbsp;&nbsp;&nbsp;"];
-	s = [s stringByReplacingOccurrencesOfString:@"  " withString:@"&nbsp;&nbsp;"];
+	BOOL charactersAreAllocated = NO;
+
+	if (characters == NULL) {
+		if (length <= _escapeStringStackBufferLength) {
+			characters = stackBuffer;
+		} else {
+			characters = malloc(sizeof(UniChar) * length);
+
+			charactersAreAllocated = YES;
+		}
+
+		CFStringGetCharacters(stringRef, CFRangeMake(0, length), characters);
+	}
+
+	CFIndex firstEscapableIndex = escapeStringFirstEscapableIndex(characters, length);
+
+	NSString *escapedString = s;
+
+	if (firstEscapableIndex < length) {
+		escapedString = escapeStringCharacters(characters, length, firstEscapableIndex);
+	}
+
+	if (charactersAreAllocated) {
+		free(characters);
+	}
 
-	return s;
+	return escapedString;
 }
 
 + (NSString *)escapeStringWithoutNil:(NSString *)s
@@ -0,0 +1,262 @@
+/* ********************************************************************* 
+                  _____         _               _
+                 |_   _|____  _| |_ _   _  __ _| |
+                   | |/ _ \ \/ / __| | | |/ _` | |
+                   | |  __/>  <| |_| |_| | (_| | |
+                   |_|\___/_/\_\\__|\__,_|\__,_|_|
+
+ Copyright (c) 2008 - 2010 Satoshi Nakagawa <psychs AT limechat DOT net>
+ Copyright (c) 2010 - 2015 Codeux Software, LLC & respective contributors.
+        Please see Acknowledgements.pdf for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Textual and/or "Codeux Software, LLC", nor the 
+      names of its contributors may be used to endorse or promote products 
+      derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+/* Private to TVCLogRenderer.m. The escaping performed by +[TVCLogRenderer escapeString:]
+ is the same as gtm_stringByEscapingForHTML followed by the replacement of tabs and
+ pairs of spaces, performed in a single pass. */
+
+#import <Foundation/Foundation.h>
+
+typedef uint16_t TVCLogRendererCharacterVector __attribute__((ext_vector_type(8)));
+typedef int16_t TVCLogRendererCharacterVectorMask __attribute__((ext_vector_type(8)));
+
+/* The non-ASCII characters that gtm_stringByEscapingForHTML replaces with a
+ named entity all fall in this range. */
+#define _escapeStringUnicodeEntityRangeStart		0x0152
+#define _escapeStringUnicodeEntityRangeEnd			0x20AC
+
+NS_INLINE NSString *unicodeEntityForCharacter(UniChar c)
+{
+	switch (c) {
+		case 0x0152: { return @"&OElig;"; }
+		case 0x0153: { return @"&oelig;"; }
+		case 0x0160: { return @"&Scaron;"; }
+		case 0x0161: { return @"&scaron;"; }
+		case 0x0178: { return @"&Yuml;"; }
+		case 0x02C6: { return @"&circ;"; }
+		case 0x02DC: { return @"&tilde;"; }
+		case 0x2002: { return @"&ensp;"; }
+		case 0x2003: { return @"&emsp;"; }
+		case 0x2009: { return @"&thinsp;"; }
+		case 0x200C: { return @"&zwnj;"; }
+		case 0x200D: { return @"&zwj;"; }
+		case 0x200E: { return @"&lrm;"; }
+		case 0x200F: { return @"&rlm;"; }
+		case 0x2013: { return @"&ndash;"; }
+		case 0x2014: { return @"&mdash;"; }
+		case 0x2018: { return @"&lsquo;"; }
+		case 0x2019: { return @"&rsquo;"; }
+		case 0x201A: { return @"&sbquo;"; }
+		case 0x201C: { return @"&ldquo;"; }
+		case 0x201D: { return @"&rdquo;"; }
+		case 0x201E: { return @"&bdquo;"; }
+		case 0x2020: { return @"&dagger;"; }
+		case 0x2021: { return @"&Dagger;"; }
+		case 0x2030: { return @"&permil;"; }
+		case 0x2039: { return @"&lsaquo;"; }
+		case 0x203A: { return @"&rsaquo;"; }
+		case 0x20AC: { return @"&euro;"; }
+	}
+
+	return nil;
+}
+
+NS_INLINE BOOL characterIsEscapable(UniChar c, UniChar nextCharacter)
+{
+	if (c >= _escapeStringUnicodeEntityRangeStart) {
+		return (c <= _escapeStringUnicodeEntityRangeEnd && unicodeEntityForCharacter(c) != nil);
+	}
+
+	return (c == '&' || c == '<' || c == '>' || c == '"' || c == '\'' || c == '\t' || (c == ' ' && nextCharacter == ' '));
+}
+
+static CFIndex escapeStringFirstEscapableIndex(const UniChar *characters, CFIndex length)
+{
+	/* Compare eight characters at a time. Each block is loaded twice, once
+	 offset by a character, so that pairs of spaces can be found too. Blocks
+	 with a character in the range of the named entities are checked one
+	 character at a time because most characters in that range have none. */
+	CFIndex i = 0;
+
+	const TVCLogRendererCharacterVector ampersand = '&';
+	const TVCLogRendererCharacterVector lessThan = '<';
+	const TVCLogRendererCharacterVector greaterThan = '>';
+	const TVCLogRendererCharacterVector quotation = '"';
+	const TVCLogRendererCharacterVector apostrophe = '\'';
+	const TVCLogRendererCharacterVector tab = '\t';
+	const TVCLogRendererCharacterVector space = ' ';
+	const TVCLogRendererCharacterVector entityRangeStart = _escapeStringUnicodeEntityRangeStart;
+	const TVCLogRendererCharacterVector entityRangeEnd = _escapeStringUnicodeEntityRangeEnd;
+
+	while ((i + 9) <= length) {
+		TVCLogRendererCharacterVector block;
+		TVCLogRendererCharacterVector nextBlock;
+
+		memcpy(&block, (characters + i), sizeof(block));
+		memcpy(&nextBlock, (characters + i + 1), sizeof(nextBlock));
+
+		TVCLogRendererCharacterVectorMask mask = ((block == ampersand) |
+												  (block == lessThan) |
+												  (block == greaterThan) |
+												  (block == quotation) |
+												  (block == apostrophe) |
+												  (block == tab) |
+												  ((block == space) & (nextBlock == space)) |
+												  ((block >= entityRangeStart) & (block <= entityRangeEnd)));
+
+		uint64_t maskBits[2];
+
+		memcpy(maskBits, &mask, sizeof(maskBits));
+
+		if ((maskBits[0] | maskBits[1]) != 0) {
+			for (CFIndex j = i; j < (i + 8); j++) {
+				if (characterIsEscapable(characters[j], characters[(j + 1)])) {
+					return j;
+				}
+			}
+		}
+
+		i += 8;
+	}
+
+	while (i < length) {
+		UniChar nextCharacter = 0;
+
+		if ((i + 1) < length) {
+			nextCharacter = characters[(i + 1)];
+		}
+
+		if (characterIsEscapable(characters[i], nextCharacter)) {
+			return i;
+		}
+
+		i += 1;
+	}
+
+	return length;
+}
+
+static NSString *escapeStringCharacters(const UniChar *characters, CFIndex length, CFIndex firstEscapableIndex)
+{
+	/* Performs the same substitutions as running gtm_stringByEscapingForHTML
+	 and then replacing tabs and pairs of spaces, but in a single pass. */
+	NSMutableString *result = [NSMutableString stringWithCapacity:(length + 32)];
+
+	CFMutableStringRef resultRef = (__bridge CFMutableStringRef)result;
+
+	CFIndex runStart = 0;
+
+	CFIndex i = firstEscapableIndex;
+
+	while (i < length) {
+		UniChar c = characters[i];
+
+		NSString *replacement = nil;
+
+		CFIndex replacedLength = 1;
+
+		switch (c) {
+			case '&':
+			{
+				replacement = @"&amp;";
+
+				break;
+			}
+			case '<':
+			{
+				replacement = @"&lt;";
+
+				break;
+			}
+			case '>':
+			{
+				replacement = @"&gt;";
+
+				break;
+			}
+			case '"':
+			{
+				replacement = @"&quot;";
+
+				break;
+			}
+			case '\'':
+			{
+				replacement = @"&apos;";
+
+				break;
+			}
+			case '\t':
+			{
+				replacement = @"&nbsp;&nbsp;&nbsp;&nbsp;";
+
+				break;
+			}
+			case ' ':
+			{
+				if ((i + 1) < length && characters[(i + 1)] == ' ') {
+					replacement = @"&nbsp;&nbsp;";
+
+					replacedLength = 2;
+				}
+
+				break;
+			}
+			default:
+			{
+				if (c >= _escapeStringUnicodeEntityRangeStart && c <= _escapeStringUnicodeEntityRangeEnd) {
+					replacement = unicodeEntityForCharacter(c);
+				}
+
+				break;
+			}
+		}
+
+		if (replacement == nil) {
+			i += 1;
+
+			continue;
+		}
+
+		if (i > runStart) {
+			CFStringAppendCharacters(resultRef, (characters + runStart), (i - runStart));
+		}
+
+		CFStringAppend(resultRef, (__bridge CFStringRef)replacement);
+
+		i += replacedLength;
+
+		runStart = i;
+	}
+
+	if (length > runStart) {
+		CFStringAppendCharacters(resultRef, (characters + runStart), (length - runStart));
+	}
+
+	return result;
+}
@@ -63,6 +63,23 @@ typedef NS_ENUM(NSUInteger, TPI_ChatFilterLimitToValue) {
 @property (nonatomic, copy) NSString *filterTitle;
 @property (readonly, copy) NSString *filterDescription;
 
+/* Compiled forms of filterMatch and filterSenderMatch. Both are nil until
+ -compileFilter is called and remain nil for an empty or invalid pattern. */
+@property (readonly, strong) NSRegularExpression *filterMatchExpression;
+@property (readonly, strong) NSRegularExpression *filterSenderMatchExpression;
+
+- (void)compileFilter;
+
+/* Counters are kept in memory only and start over when the filter is edited.
+ Time is measured in nanoseconds. */
+@property (readonly, assign) NSUInteger filterEvaluationCount;
+@property (readonly, assign) NSUInteger filterHitCount;
+@property (readonly, assign) uint64_t filterTotalEvaluationTime;
+@property (readonly, assign) uint64_t filterLongestEvaluationTime;
+@property (readonly, copy) NSString *filterStatisticsDescription;
+
+- (void)recordEvaluationTime:(uint64_t)evaluationTime matched:(BOOL)matched;
+
 - (instancetype)initWithDictionary:(NSDictionary *)dict;
 - (NSDictionary *)dictionaryValue;
 @end
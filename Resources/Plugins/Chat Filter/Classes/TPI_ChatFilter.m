@@ -37,6 +37,15 @@
 
 #import "TPI_ChatFilter.h"
 
+@interface TPI_ChatFilter ()
+@property (readwrite, strong) NSRegularExpression *filterMatchExpression;
+@property (readwrite, strong) NSRegularExpression *filterSenderMatchExpression;
+@property (readwrite, assign) NSUInteger filterEvaluationCount;
+@property (readwrite, assign) NSUInteger filterHitCount;
+@property (readwrite, assign) uint64_t filterTotalEvaluationTime;
+@property (readwrite, assign) uint64_t filterLongestEvaluationTime;
+@end
+
 @implementation TPI_ChatFilter
 
 - (instancetype)init
@@ -154,6 +163,62 @@
 	return [[TPI_ChatFilter allocWithZone:zone] initWithDictionary:[self dictionaryValue]];
 }
 
+- (void)compileFilter
+{
+	/* Patterns were previously matched without case on every message. */
+	NSRegularExpression *filterMatchExpression = nil;
+
+	NSRegularExpression *filterSenderMatchExpression = nil;
+
+	if (NSObjectIsNotEmpty(self.filterMatch)) {
+		filterMatchExpression = [NSRegularExpression regularExpressionWithPattern:self.filterMatch
+																		  options:NSRegularExpressionCaseInsensitive
+																			error:NULL];
+	}
+
+	if (NSObjectIsNotEmpty(self.filterSenderMatch)) {
+		filterSenderMatchExpression = [NSRegularExpression regularExpressionWithPattern:self.filterSenderMatch
+																				options:NSRegularExpressionCaseInsensitive
+																				  error:NULL];
+	}
+
+	self.filterMatchExpression = filterMatchExpression;
+
+	self.filterSenderMatchExpression = filterSenderMatchExpression;
+}
+
+- (void)recordEvaluationTime:(uint64_t)evaluationTime matched:(BOOL)matched
+{
+	@synchronized(self) {
+		self.filterEvaluationCount += 1;
+
+		if (matched) {
+			self.filterHitCount += 1;
+		}
+
+		self.filterTotalEvaluationTime += evaluationTime;
+
+		if (self.filterLongestEvaluationTime < evaluationTime) {
+			self.filterLongestEvaluationTime = evaluationTime;
+		}
+	}
+}
+
+- (NSString *)filterStatisticsDescription
+{
+	@synchronized(self) {
+		if (self.filterEvaluationCount == 0) {
+			return TPILocalizedString(@"TPI_ChatFilter[0004]");
+		}
+
+		double averageTime = ((double)self.filterTotalEvaluationTime / (double)self.filterEvaluationCount / 1000.0);
+
+		double longestTime = ((double)self.filterLongestEvaluationTime / 1000.0);
+
+		return TPILocalizedString(@"TPI_ChatFilter[0005]", self.filterHitCount, self.filterEvaluationCount, averageTime, longestTime);
+	}
+}
+
 - (NSString *)filterDescription
 {
 	NSString *filterMatch = [self filterMatch];
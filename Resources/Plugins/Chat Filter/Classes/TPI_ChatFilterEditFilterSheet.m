@@ -45,6 +45,7 @@
 @property (nonatomic, weak) IBOutlet NSTextField *filterSenderMatchTextField;
 @property (nonatomic, weak) IBOutlet NSTextField *filterTitleTextField;
 @property (nonatomic, weak) IBOutlet NSTextField *filterNotesTextField;
+@property (nonatomic, weak) IBOutlet NSTextField *filterStatisticsTextField;
 @property (nonatomic, weak) IBOutlet TVCTextFieldWithValueValidation *filterForwardToDestinationTextField;
 @property (nonatomic, weak) IBOutlet TPI_ChatFilterFilterActionTokenField *filterActionTokenField;
 @property (nonatomic, weak) IBOutlet NSTokenField *filterActionTokenChannelName;
@@ -124,8 +125,13 @@
 {
 	if (filter == nil) {
 		self.filter = [TPI_ChatFilter new];
+
+		[self.filterStatisticsTextField setStringValue:NSStringEmptyPlaceholder];
 	} else {
 		self.filter = filter;
+
+		/* Counters are not carried by copies so they are read from the original. */
+		[self.filterStatisticsTextField setStringValue:[filter filterStatisticsDescription]];
 	}
 
 	[self addObserverForChannelListUpdates];
@@ -38,8 +38,30 @@
 #import "TPI_ChatFilterExtension.h"
 #import "TPI_ChatFilterEditFilterSheet.h"
 
+#import <mach/mach_time.h>
+
 #define _filterListUserDefaultsKey		@"Textual Chat Filter Extension -> Filters"
 
+/* Filters sorted by the line types and destinations that they apply to.
+ An index is immutable and is replaced each time the filters are saved. */
+@interface TPI_ChatFilterIndex : NSObject
+- (instancetype)initWithFilters:(NSArray *)filters;
+
+- (NSArray *)filtersForLineType:(TVCLogLineType)lineType destinedFor:(IRCChannel *)textDestination onClient:(IRCClient *)client;
+@end
+
+@interface TPI_ChatFilterIndex ()
+@property (nonatomic, copy) NSArray *filters;
+@property (nonatomic, copy) NSIndexSet *privateMessageTypeFilters;
+@property (nonatomic, copy) NSIndexSet *actionTypeFilters;
+@property (nonatomic, copy) NSIndexSet *noticeTypeFilters;
+@property (nonatomic, copy) NSIndexSet *unlimitedFilters;
+@property (nonatomic, copy) NSIndexSet *channelFilters;
+@property (nonatomic, copy) NSIndexSet *privateMessageFilters;
+@property (nonatomic, copy) NSDictionary *clientFilters;
+@property (nonatomic, copy) NSDictionary *channelItemFilters;
+@end
+
 @interface TPI_ChatFilterExtension ()
 @property (nonatomic, strong) IBOutlet NSView *preferencesPaneView;
 @property (nonatomic, weak) IBOutlet NSButton *filterAddButton;
@@ -50,6 +72,7 @@
 @property (nonatomic, assign) BOOL atleastOneFilterExists;
 @property (nonatomic, assign) NSInteger activeChatFilterIndex;
 @property (nonatomic, strong) TPI_ChatFilterEditFilterSheet *activeChatFilterEditSheet;
+@property (strong) TPI_ChatFilterIndex *filterIndex;
 
 - (IBAction)filterTableDoubleClicked:(id)sender;
 
@@ -72,172 +95,191 @@
 
 - (BOOL)receivedText:(NSString *)text authoredBy:(IRCPrefix *)textAuthor destinedFor:(IRCChannel *)textDestination asLineType:(TVCLogLineType)lineType onClient:(IRCClient *)client receivedAt:(NSDate *)receivedAt wasEncrypted:(BOOL)wasEncrypted
 {
+	/* Only filters interested in the line type and destination of the input are returned. */
+	NSArray *filters = [self.filterIndex filtersForLineType:lineType destinedFor:textDestination onClient:client];
+
+	if ([filters count] == 0) {
+		return YES;
+	}
+
 	/* Begin processing filters */
 	IRCUser *senderUser = nil;
 
-	@synchronized([self.filterArrayController arrangedObjects]) {
-		NSArray *arrangedObjects = [self.filterArrayController arrangedObjects];
+	NSRange textRange = NSMakeRange(0, [text length]);
 
-		for (TPI_ChatFilter *filter in arrangedObjects) {
-			@autoreleasepool {
-				if ((lineType == TVCLogLinePrivateMessageType && [filter filterCommandPRIVMSG] == NO) ||
-					(lineType == TVCLogLineActionType && [filter filterCommandPRIVMSG_ACTION] == NO) ||
-					(lineType == TVCLogLineNoticeType && [filter filterCommandNOTICE] == NO))
-				{
-					/* Continue to next filter. This filter is not interested
-					  in the line type of the input. */
+	for (TPI_ChatFilter *filter in filters) {
+		@autoreleasepool {
+			/* Try to resolve destination channel now that we 
+			 know that there is a filter that will need it. */
+			TPI_ChatFilterLimitToValue filterLimitedToValue = [filter filterLimitedToValue];
 
-					continue;
+			if (filterLimitedToValue != TPI_ChatFilterLimitToNoLimitValue || [filter filterIgnoresOperators]) {
+				if (textDestination == nil && [textAuthor isServer] == NO) {
+					LogToConsole(@"textDestination == nil — Returning input instead of continuing with filter");
+
+					return YES;
 				}
+			}
 
-				/* Try to resolve destination channel now that we 
-				 know that there is a filter that will need it. */
-				TPI_ChatFilterLimitToValue filterLimitedToValue = [filter filterLimitedToValue];
+			if (filterLimitedToValue == TPI_ChatFilterLimitToChannelsValue) {
+				if ([textDestination isChannel] == NO) {
+					/* Filter is limited to a channel but the destination
+					 is not a channel. */
 
-				if (filterLimitedToValue != TPI_ChatFilterLimitToNoLimitValue || [filter filterIgnoresOperators]) {
-					if (textDestination == nil && [textAuthor isServer] == NO) {
-						LogToConsole(@"textDestination == nil — Returning input instead of continuing with filter");
+					continue;
+				}
+			} else if (filterLimitedToValue == TPI_ChatFilterLimitToPrivateMessagesValue) {
+				if ([textDestination isPrivateMessage] == NO) {
+					/* Filter is limited to a private message but the destination
+					 is not a private message. */
 
-						return YES;
-					}
+					continue;
 				}
+			} else if (filterLimitedToValue == TPI_ChatFilterLimitToSpecificItemsValue) {
+				NSArray *filterLimitedToClientsIDs = [filter filterLimitedToClientsIDs];
+				NSArray *filterLimitedToChannelsIDs = [filter filterLimitedToChannelsIDs];
 
-				if (filterLimitedToValue == TPI_ChatFilterLimitToChannelsValue) {
-					if ([textDestination isChannel] == NO) {
-						/* Filter is limited to a channel but the destination
-						 is not a channel. */
+				if ([filterLimitedToClientsIDs containsObject:[client uniqueIdentifier]] == NO &&
+					[filterLimitedToChannelsIDs containsObject:[textDestination uniqueIdentifier]] == NO)
+				{
+					/* Target channel is not covered by current filter. */
 
-						continue;
-					}
-				} else if (filterLimitedToValue == TPI_ChatFilterLimitToPrivateMessagesValue) {
-					if ([textDestination isPrivateMessage] == NO) {
-						/* Filter is limited to a private message but the destination
-						 is not a private message. */
+					continue;
+				}
+			}
 
-						continue;
-					}
-				} else if (filterLimitedToValue == TPI_ChatFilterLimitToSpecificItemsValue) {
-					NSArray *filterLimitedToClientsIDs = [filter filterLimitedToClientsIDs];
-					NSArray *filterLimitedToChannelsIDs = [filter filterLimitedToChannelsIDs];
+			uint64_t evaluationStartTime = mach_absolute_time();
 
-					if ([filterLimitedToClientsIDs containsObject:[client uniqueIdentifier]] == NO &&
-						[filterLimitedToChannelsIDs containsObject:[textDestination uniqueIdentifier]] == NO)
-					{
-						/* Target channel is not covered by current filter. */
+			/* Maybe perform filter action on sender hostmask */
+			if (NSObjectIsEmpty([filter filterSenderMatch]) == NO) {
+				NSString *comparisonHostmask = nil;
 
-						continue;
-					}
+				if ([textAuthor isServer]) {
+					comparisonHostmask = [textAuthor nickname]; // Server address
+				} else {
+					comparisonHostmask = [textAuthor hostmask];
 				}
 
-				/* Maybe perform filter action on sender hostmask */
-				NSString *filterSenderMatch = [filter filterSenderMatch];
-
-				if (NSObjectIsEmpty(filterSenderMatch) == NO) {
-					NSString *comparisonHostmask = nil;
+				NSRegularExpression *filterSenderMatchExpression = [filter filterSenderMatchExpression];
 
-					if ([textAuthor isServer]) {
-						comparisonHostmask = [textAuthor nickname]; // Server address
-					} else {
-						comparisonHostmask = [textAuthor hostmask];
-					}
-
-					if ([XRRegularExpression string:comparisonHostmask isMatchedByRegex:filterSenderMatch withoutCase:YES] == NO) {
-						/* If a filter specifies a sender match and the match for
-						 this particular filter fails, then skip this filter. */
+				if (filterSenderMatchExpression == nil || comparisonHostmask == nil ||
+					[filterSenderMatchExpression firstMatchInString:comparisonHostmask options:0 range:NSMakeRange(0, [comparisonHostmask length])] == nil)
+				{
+					/* If a filter specifies a sender match and the match for
+					 this particular filter fails, then skip this filter. */
+					[self recordEvaluationForFilter:filter sinceTime:evaluationStartTime matched:NO];
 
-						continue;
-					}
+					continue;
 				}
+			}
 
-				/* Find author in the channel */
-				if ([filter filterIgnoresOperators] && [textDestination isChannel]) {
-					if ([textAuthor isServer] == NO) {
-						if (senderUser == nil) {
-							senderUser = [textDestination findMember:[textAuthor nickname]];
-
-							if (senderUser) {
-								if ([senderUser isHalfOp]) {
-									/* User is at least a Half-op, ignore this filter. */
+			/* Find author in the channel */
+			if ([filter filterIgnoresOperators] && [textDestination isChannel]) {
+				if ([textAuthor isServer] == NO) {
+					if (senderUser == nil) {
+						senderUser = [textDestination findMember:[textAuthor nickname]];
 
-									continue;
-								}
-							} else {
-								LogToConsole(@"senderUser == nil — Skipping to next filter");
+						if (senderUser) {
+							if ([senderUser isHalfOp]) {
+								/* User is at least a Half-op, ignore this filter. */
 
 								continue;
 							}
+						} else {
+							LogToConsole(@"senderUser == nil — Skipping to next filter");
+
+							continue;
 						}
 					}
 				}
+			}
 
-				/* Filter text */
-				if ([XRRegularExpression string:text isMatchedByRegex:[filter filterMatch] withoutCase:YES] == NO) {
-					/* The input text is not matched by the filter match.
-					 Continue to the next filter to try again. */
+			/* Filter text */
+			BOOL textMatched = ([[filter filterMatchExpression] firstMatchInString:text options:0 range:textRange] != nil);
 
-					continue;
-				} else {
-					/* Perform actions defined by filter */
-					XRPerformBlockAsynchronouslyOnMainQueue(^{
-						[self performActionForFilter:filter
-								 withOriginalMessage:text
-										  authoredBy:textAuthor
-										 destinedFor:textDestination
-										  asLineType:lineType
-											onClient:client];
-					});
-
-					/* Forward a copy of the message to a query? */
-					NSString *filterForwardToDestination = [filter filterForwardToDestination];
-
-					if (NSObjectIsNotEmpty(filterForwardToDestination)) {
-						IRCChannel *destinationChannel = [client findChannelOrCreate:filterForwardToDestination isPrivateMessage:YES];
-
-						NSString *fakeMessageCommand = nil;
-
-						if (lineType == TVCLogLinePrivateMessageType ||
-							lineType == TVCLogLineActionType)
-						{
-							fakeMessageCommand = @"PRIVMSG";
-						} else if (lineType == TVCLogLineNoticeType) {
-							fakeMessageCommand = @"NOTICE";
-						}
+			[self recordEvaluationForFilter:filter sinceTime:evaluationStartTime matched:textMatched];
 
-						[client printToWebView:destinationChannel
-										  type:lineType
-									   command:fakeMessageCommand
-									  nickname:[textAuthor nickname]
-								   messageBody:text
-								   isEncrypted:wasEncrypted
-									receivedAt:receivedAt
-							  referenceMessage:nil
-							   completionBlock:^(BOOL isHighlight) {
-								   if (lineType == TVCLogLineNoticeType) {
-									   [client setUnreadState:destinationChannel];
-								   } else {
-									   if (isHighlight) {
-										   [client setKeywordState:destinationChannel];
-									   }
-
-									   [client setUnreadState:destinationChannel isHighlight:isHighlight];
-								   }
-							   }];
-					}
+			if (textMatched == NO) {
+				/* The input text is not matched by the filter match.
+				 Continue to the next filter to try again. */
+
+				continue;
+			} else {
+				/* Perform actions defined by filter */
+				XRPerformBlockAsynchronouslyOnMainQueue(^{
+					[self performActionForFilter:filter
+							 withOriginalMessage:text
+									  authoredBy:textAuthor
+									 destinedFor:textDestination
+									  asLineType:lineType
+										onClient:client];
+				});
 
-					if ([filter filterIgnoreContent]) {
-						return NO; // Ignore original content
+				/* Forward a copy of the message to a query? */
+				NSString *filterForwardToDestination = [filter filterForwardToDestination];
+
+				if (NSObjectIsNotEmpty(filterForwardToDestination)) {
+					IRCChannel *destinationChannel = [client findChannelOrCreate:filterForwardToDestination isPrivateMessage:YES];
+
+					NSString *fakeMessageCommand = nil;
+
+					if (lineType == TVCLogLinePrivateMessageType ||
+						lineType == TVCLogLineActionType)
+					{
+						fakeMessageCommand = @"PRIVMSG";
+					} else if (lineType == TVCLogLineNoticeType) {
+						fakeMessageCommand = @"NOTICE";
 					}
 
-					/* Return once the first filter matches */
-					return YES;
+					[client printToWebView:destinationChannel
+									  type:lineType
+								   command:fakeMessageCommand
+								  nickname:[textAuthor nickname]
+							   messageBody:text
+							   isEncrypted:wasEncrypted
+								receivedAt:receivedAt
+						  referenceMessage:nil
+						   completionBlock:^(BOOL isHighlight) {
+							   if (lineType == TVCLogLineNoticeType) {
+								   [client setUnreadState:destinationChannel];
+							   } else {
+								   if (isHighlight) {
+									   [client setKeywordState:destinationChannel];
+								   }
+
+								   [client setUnreadState:destinationChannel isHighlight:isHighlight];
+							   }
+						   }];
+				}
+
+				if ([filter filterIgnoreContent]) {
+					return NO; // Ignore original content
 				}
-			} // @autorelease
-		} // for
-	} // @synchronized
+
+				/* Return once the first filter matches */
+				return YES;
+			}
+		} // @autorelease
+	} // for
 
 	return YES;
 }
 
+- (void)recordEvaluationForFilter:(TPI_ChatFilter *)filter sinceTime:(uint64_t)startTime matched:(BOOL)matched
+{
+	static mach_timebase_info_data_t timebaseInfo;
+
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		mach_timebase_info(&timebaseInfo);
+	});
+
+	uint64_t elapsedTime = ((mach_absolute_time() - startTime) * timebaseInfo.numer / timebaseInfo.denom);
+
+	[filter recordEvaluationTime:elapsedTime matched:matched];
+}
+
 - (void)performActionForFilter:(TPI_ChatFilter *)filter withOriginalMessage:(NSString *)text authoredBy:(IRCPrefix *)textAuthor destinedFor:(IRCChannel *)textDestination asLineType:(TVCLogLineType)lineType onClient:(IRCClient *)client
 {
 	NSString *filterActionData = [filter filterAction];
@@ -308,6 +350,8 @@
 		}
 	}
 
+	[self rebuildFilterIndex];
+
 	[self reloadFilterCount];
 }
 
@@ -323,9 +367,22 @@
 
 	[RZUserDefaults() setObject:[filterDictionaries copy] forKey:_filterListUserDefaultsKey];
 
+	[self rebuildFilterIndex];
+
 	[self reloadFilterCount];
 }
 
+- (void)rebuildFilterIndex
+{
+	NSArray *arrangedObjects = [self.filterArrayController arrangedObjects];
+
+	for (TPI_ChatFilter *filter in arrangedObjects) {
+		[filter compileFilter];
+	}
+
+	self.filterIndex = [[TPI_ChatFilterIndex alloc] initWithFilters:arrangedObjects];
+}
+
 - (void)reloadFilterCount
 {
 	NSArray *arrangedObjects = [self.filterArrayController arrangedObjects];
@@ -436,3 +493,167 @@
 }
 
 @end
+
+#pragma mark -
+
+@implementation TPI_ChatFilterIndex
+
+- (instancetype)initWithFilters:(NSArray *)filters
+{
+	if ((self = [super init])) {
+		NSMutableArray *indexedFilters = [NSMutableArray arrayWithCapacity:[filters count]];
+
+		NSMutableIndexSet *privateMessageTypeFilters = [NSMutableIndexSet indexSet];
+		NSMutableIndexSet *actionTypeFilters = [NSMutableIndexSet indexSet];
+		NSMutableIndexSet *noticeTypeFilters = [NSMutableIndexSet indexSet];
+
+		NSMutableIndexSet *unlimitedFilters = [NSMutableIndexSet indexSet];
+		NSMutableIndexSet *channelFilters = [NSMutableIndexSet indexSet];
+		NSMutableIndexSet *privateMessageFilters = [NSMutableIndexSet indexSet];
+
+		NSMutableDictionary *clientFilters = [NSMutableDictionary dictionary];
+		NSMutableDictionary *channelItemFilters = [NSMutableDictionary dictionary];
+
+		for (TPI_ChatFilter *filter in filters) {
+			/* A filter without a valid match can never perform its action. */
+			if ([filter filterMatchExpression] == nil) {
+				continue;
+			}
+
+			NSUInteger filterIndex = [indexedFilters count];
+
+			[indexedFilters addObject:filter];
+
+			if ([filter filterCommandPRIVMSG]) {
+				[privateMessageTypeFilters addIndex:filterIndex];
+			}
+
+			if ([filter filterCommandPRIVMSG_ACTION]) {
+				[actionTypeFilters addIndex:filterIndex];
+			}
+
+			if ([filter filterCommandNOTICE]) {
+				[noticeTypeFilters addIndex:filterIndex];
+			}
+
+			switch ([filter filterLimitedToValue]) {
+				case TPI_ChatFilterLimitToChannelsValue:
+				{
+					[channelFilters addIndex:filterIndex];
+
+					break;
+				}
+				case TPI_ChatFilterLimitToPrivateMessagesValue:
+				{
+					[privateMessageFilters addIndex:filterIndex];
+
+					break;
+				}
+				case TPI_ChatFilterLimitToSpecificItemsValue:
+				{
+					[self addFilterIndex:filterIndex toTable:clientFilters forKeys:[filter filterLimitedToClientsIDs]];
+
+					[self addFilterIndex:filterIndex toTable:channelItemFilters forKeys:[filter filterLimitedToChannelsIDs]];
+
+					break;
+				}
+				default:
+				{
+					[unlimitedFilters addIndex:filterIndex];
+
+					break;
+				}
+			}
+		}
+
+		self.filters = indexedFilters;
+
+		self.privateMessageTypeFilters = privateMessageTypeFilters;
+		self.actionTypeFilters = actionTypeFilters;
+		self.noticeTypeFilters = noticeTypeFilters;
+
+		self.unlimitedFilters = unlimitedFilters;
+		self.channelFilters = channelFilters;
+		self.privateMessageFilters = privateMessageFilters;
+
+		self.clientFilters = clientFilters;
+		self.channelItemFilters = channelItemFilters;
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)addFilterIndex:(NSUInteger)filterIndex toTable:(NSMutableDictionary *)table forKeys:(NSArray *)keys
+{
+	for (NSString *key in keys) {
+		NSMutableIndexSet *indexes = table[key];
+
+		if (indexes == nil) {
+			indexes = [NSMutableIndexSet indexSet];
+
+			table[key] = indexes;
+		}
+
+		[indexes addIndex:filterIndex];
+	}
+}
+
+- (NSArray *)filtersForLineType:(TVCLogLineType)lineType destinedFor:(IRCChannel *)textDestination onClient:(IRCClient *)client
+{
+	NSObjectIsEmptyAssertReturn(self.filters, nil);
+
+	NSIndexSet *lineTypeFilters = nil;
+
+	if (lineType == TVCLogLinePrivateMessageType) {
+		lineTypeFilters = self.privateMessageTypeFilters;
+	} else if (lineType == TVCLogLineActionType) {
+		lineTypeFilters = self.actionTypeFilters;
+	} else if (lineType == TVCLogLineNoticeType) {
+		lineTypeFilters = self.noticeTypeFilters;
+	}
+
+	NSMutableIndexSet *candidateFilters = nil;
+
+	if (textDestination == nil) {
+		/* Without a destination every filter is a candidate. Limited
+		 filters are then left to decide how to treat the input. */
+		candidateFilters = [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [self.filters count])];
+	} else {
+		candidateFilters = [self.unlimitedFilters mutableCopy];
+
+		if ([textDestination isChannel]) {
+			[candidateFilters addIndexes:self.channelFilters];
+		} else if ([textDestination isPrivateMessage]) {
+			[candidateFilters addIndexes:self.privateMessageFilters];
+		}
+
+		NSIndexSet *clientFilters = self.clientFilters[[client uniqueIdentifier]];
+
+		if (clientFilters) {
+			[candidateFilters addIndexes:clientFilters];
+		}
+
+		NSIndexSet *channelItemFilters = self.channelItemFilters[[textDestination uniqueIdentifier]];
+
+		if (channelItemFilters) {
+			[candidateFilters addIndexes:channelItemFilters];
+		}
+	}
+
+	/* Filters that are not interested in the line type are removed. */
+	if (lineTypeFilters) {
+		NSIndexSet *uninterestedFilters = [candidateFilters indexesPassingTest:^BOOL(NSUInteger idx, BOOL *stop) {
+			return ([lineTypeFilters containsIndex:idx] == NO);
+		}];
+
+		[candidateFilters removeIndexes:uninterestedFilters];
+	}
+
+	/* Indexes are enumerated in ascending order which keeps
+	 the filters in the order that the user arranged them. */
+	return [self.filters objectsAtIndexes:candidateFilters];
+}
+
+@end
@@ -92,6 +92,54 @@ Textual.scrollToBottomOfView = function(fireNotification)
 	}
 };
 
+/* Scrollback management. */
+/* Removes the line firstLineNumber, the line lastLineNumber, and every line
+between them. Only line elements are removed. Anything else between them such
+as the history indicator or a date separator added by a style is left alone.
+If the first line is no longer in the view, removal starts at the oldest line
+that is. Returns false without removing anything if the last line is not in
+the view or does not come after the first line. */
+Textual.removeLinesFromView = function(firstLineNumber, lastLineNumber)
+{
+	var firstLine = document.getElementById("line-" + firstLineNumber);
+	var lastLine = document.getElementById("line-" + lastLineNumber);
+
+	if (lastLine === null) {
+		return false;
+	}
+
+	var lineElements = document.querySelectorAll("[id^='line-']");
+
+	var firstIndex = -1;
+	var lastIndex = -1;
+
+	for (var i = 0; i < lineElements.length; i++) {
+		var lineElement = lineElements[i];
+
+		if (firstIndex < 0 && (firstLine === null || lineElement === firstLine)) {
+			firstIndex = i;
+		}
+
+		if (lineElement === lastLine) {
+			lastIndex = i;
+
+			break;
+		}
+	}
+
+	if (firstIndex < 0 || lastIndex < firstIndex) {
+		return false;
+	}
+
+	for (var j = firstIndex; j <= lastIndex; j++) {
+		var prunedLine = lineElements[j];
+
+		prunedLine.parentNode.removeChild(prunedLine);
+	}
+
+	return true;
+};
+
 Textual.notifyDidBecomeVisible = function()
 {
 	window.getSelection().empty();
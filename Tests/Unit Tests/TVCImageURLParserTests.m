@@ -0,0 +1,155 @@
+/* ********************************************************************* 
+                  _____         _               _
+                 |_   _|____  _| |_ _   _  __ _| |
+                   | |/ _ \ \/ / __| | | |/ _` | |
+                   | |  __/>  <| |_| |_| | (_| | |
+                   |_|\___/_/\_\\__|\__,_|\__,_|_|
+
+ Copyright (c) 2008 - 2010 Satoshi Nakagawa <psychs AT limechat DOT net>
+ Copyright (c) 2010 - 2015 Codeux Software, LLC & respective contributors.
+        Please see Acknowledgements.pdf for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Textual and/or "Codeux Software, LLC", nor the 
+      names of its contributors may be used to endorse or promote products 
+      derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+/* The "Unit Tests" target builds these files into an XCTest bundle that uses
+ Textual (Debug) as its test host (TEST_HOST and BUNDLE_LOADER point at the
+ copy of Textual being built) so that they link against the application the
+ same way plugins do. They are run by the Test action of the Debug scheme. */
+
+#import "TextualApplication.h"
+
+#import <XCTest/XCTest.h>
+
+@interface TVCImageURLParserTests : XCTestCase
+@end
+
+@implementation TVCImageURLParserTests
+
+- (void)assertRewrites:(NSArray *)rewrites
+{
+	/* Each entry is the link that was posted followed by the image that is
+	 expected to be presented for it or NSNull when nothing should be. */
+	for (NSArray *rewrite in rewrites) {
+		NSString *url = rewrite[0];
+
+		id expectedResult = rewrite[1];
+
+		if (expectedResult == [NSNull null]) {
+			expectedResult = nil;
+		}
+
+		NSString *actualResult = [TVCImageURLParser imageURLFromBase:url];
+
+		XCTAssertEqualObjects(actualResult, expectedResult, @"Unexpected result for %@", url);
+
+		/* The second lookup is answered by the result cache. */
+		actualResult = [TVCImageURLParser imageURLFromBase:url];
+
+		XCTAssertEqualObjects(actualResult, expectedResult, @"Unexpected cached result for %@", url);
+	}
+}
+
+- (void)testHostRewrites
+{
+	[self assertRewrites:@[
+		@[@"https://www.dropbox.com/s/abc123/photo.png",			@"https://dl.dropboxusercontent.com/s/abc123/photo.png"],
+		@[@"https://www.dropbox.com/s/abc123/notes",				[NSNull null]],
+		@[@"http://instacod.es/12345",								@"http://instacod.es/file/12345"],
+		@[@"https://docs.google.com/file/d/0B1a2b3c/edit",			@"https://docs.google.com/uc?id=0B1a2b3c"],
+		@[@"https://docs.google.com/file/d/0B1a2b3c",				@"https://docs.google.com/uc?id=0B1a2b3c"],
+		@[@"https://docs.google.com/file/d/0B1a2b3c/view",			[NSNull null]],
+		@[@"https://docs.google.com/file/d/0B1a2b3c/edit/more",	[NSNull null]],
+		@[@"https://pbs.twimg.com/media/CAbc123",					@"https://pbs.twimg.com//media/CAbc123:orig"],
+		@[@"https://pbs.twimg.com/media/CAbc123.jpg",				@"https://pbs.twimg.com/media/CAbc123.jpg"],
+		@[@"http://yfrog.com/abc12",								@"http://yfrog.com/abc12:iphone"],
+		@[@"http://www.yfrog.com/abc12",							@"http://www.yfrog.com/abc12:iphone"],
+		@[@"http://twitpic.com/abc12",								@"http://twitpic.com/show/large/abc12"],
+		@[@"http://twitpic.com/abc12/full",							@"http://twitpic.com/show/large/abc12"],
+		@[@"http://cl.ly/image/0a1b2c3d4e5f",						@"http://cl.ly/0a1b2c3d4e5f/content"],
+		@[@"http://twitgoo.com/abc12",								@"http://twitgoo.com/show/Img/abc12"],
+		@[@"http://img.ly/abc12",									@"http://img.ly/show/large/abc12"],
+		@[@"https://leetfil.es/image/abc12",						@"https://i.leetfil.es/abc12"],
+		@[@"https://leetfil.es/video/abc12",						@"https://leetfil.es/vid/abc12_thumb.png"],
+		@[@"http://movapic.com/pic/abc12",							@"http://image.movapic.com/pic/m_abc12.jpeg"],
+		@[@"http://f.hatena.ne.jp/textual/20150101123456",			@"http://img.f.hatena.ne.jp/images/fotolife/t/textual/20150101/20150101123456.jpg"],
+		@[@"http://puu.sh/abc12",									@"http://puu.sh/abc12.jpg"],
+		@[@"http://d.pr/i/abc12",									@"http://d.pr/i/abc12.png"],
+		@[@"https://www.youtube.com/watch?v=dQw4w9WgXcQ",			@"http://i.ytimg.com/vi/dQw4w9WgXcQ/mqdefault.jpg"],
+		@[@"https://www.youtube.com/watch?feature=share&v=dQw4w9WgXcQxyz", @"http://i.ytimg.com/vi/dQw4w9WgXcQ/mqdefault.jpg"],
+		@[@"http://youtu.be/dQw4w9WgXcQ",							@"http://i.ytimg.com/vi/dQw4w9WgXcQ/mqdefault.jpg"],
+		@[@"http://www.nicovideo.jp/watch/sm12345",					@"http://tn-skr2.smilevideo.jp/smile?i=12345"],
+		@[@"http://nico.ms/sm12345",								@"http://tn-skr2.smilevideo.jp/smile?i=12345"],
+		@[@"http://fukung.net/v/123/abc.jpg",						@"http://media.fukung.net/images/123/abc.jpg"],
+		@[@"http://files.example.com/image/0a1b2c3d4e5f",			@"http://cl.ly/image/0a1b2c3d4e5f/content"],
+		@[@"file:///Users/textual/Pictures/photo.png",				[NSNull null]],
+	]];
+}
+
+- (void)testTweetPhotoRewrite
+{
+	/* The link is handed to the TweetPhoto API as a query argument. */
+	NSString *url = @"http://tweetphoto.com/12345";
+
+	NSString *expectedResult = [NSString stringWithFormat:@"http://TweetPhotoAPI.com/api/TPAPI.svc/imagefromurl?size=medium&url=%@", [url encodeURIComponent]];
+
+	[self assertRewrites:@[
+		@[url,														expectedResult],
+	]];
+}
+
+- (void)testDomainRulesMatchOnLabelBoundaries
+{
+	/* A rule for a domain applies to the domain and its subdomains but not to
+	 a different domain that merely ends with the same characters. */
+	[self assertRewrites:@[
+		@[@"https://dropbox.com/s/abc123/photo.png",				@"https://dl.dropboxusercontent.com/s/abc123/photo.png"],
+		@[@"https://notdropbox.com/s/abc123/photo.png",			@"https://notdropbox.com/s/abc123/photo.png"],
+		@[@"https://en.wikipedia.org/wiki/File:Photo.jpg",			[NSNull null]],
+		@[@"https://notwikipedia.org/wiki/Photo.jpg",				@"https://notwikipedia.org/wiki/Photo.jpg"],
+		@[@"https://m.youtube.com/watch?v=dQw4w9WgXcQ",				@"http://i.ytimg.com/vi/dQw4w9WgXcQ/mqdefault.jpg"],
+		@[@"https://notyoutube.com/watch?v=dQw4w9WgXcQ",			[NSNull null]],
+		@[@"http://mytwitpic.com/abc12",							[NSNull null]],
+		@[@"http://www.puu.sh/abc12",								[NSNull null]],
+		@[@"http://youtu.be.example.com/dQw4w9WgXcQ",				[NSNull null]],
+	]];
+}
+
+- (void)testImageExtensionIsReadAfterLastPeriod
+{
+	[self assertRewrites:@[
+		@[@"http://example.com/photo.png",							@"http://example.com/photo.png"],
+		@[@"http://example.com/photo.JPG",							@"http://example.com/photo.JPG"],
+		@[@"http://example.com/photo.final.jpeg",					@"http://example.com/photo.final.jpeg"],
+		@[@"http://example.com/archive.png.zip",					[NSNull null]],
+		@[@"http://example.com/photopng",							[NSNull null]],
+		@[@"http://example.com/view?file=photo.gif",				@"http://example.com/view?file=photo.gif"],
+		@[@"http://example.com/view.gif?size=large",				@"http://example.com/view.gif?size=large"],
+	]];
+}
+
+@end
@@ -0,0 +1,407 @@
+/* ********************************************************************* 
+                  _____         _               _
+                 |_   _|____  _| |_ _   _  __ _| |
+                   | |/ _ \ \/ / __| | | |/ _` | |
+                   | |  __/>  <| |_| |_| | (_| | |
+                   |_|\___/_/\_\\__|\__,_|\__,_|_|
+
+ Copyright (c) 2008 - 2010 Satoshi Nakagawa <psychs AT limechat DOT net>
+ Copyright (c) 2010 - 2015 Codeux Software, LLC & respective contributors.
+        Please see Acknowledgements.pdf for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Textual and/or "Codeux Software, LLC", nor the 
+      names of its contributors may be used to endorse or promote products 
+      derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "TextualApplication.h"
+
+#import <XCTest/XCTest.h>
+
+#define _standInHost					@"textual-tests.invalid"
+
+#define _standInResponseDelay			0.2
+
+/* Stands in for a web server by answering every request made to _standInHost
+ itself. Paths starting with /missing/ are answered with 404 Not Found and
+ everything else with a 1x1 PNG image. Each answer is held back for a moment
+ so that requests overlap and the number open at one time can be counted. */
+@interface TVCImageURLoaderTestsStandInServer : NSURLProtocol
++ (void)resetStatistics;
+
++ (NSInteger)numberOfRequests;
++ (NSInteger)numberOfRequestsForPath:(NSString *)path;
++ (NSInteger)maximumNumberOfConcurrentRequests;
+@end
+
+@interface TVCImageURLoaderTests : XCTestCase <TVCImageURLoaderDelegate>
+@property (nonatomic, strong) NSMutableDictionary *results; // uniqueID -> @(isSafe)
+@property (nonatomic, strong) NSMutableArray *loaders;
+@property (nonatomic, strong) XCTestExpectation *resultsExpectation;
+@property (nonatomic, assign) NSInteger expectedResultCount;
+@end
+
+@implementation TVCImageURLoaderTests
+
+- (void)setUp
+{
+	[super setUp];
+
+	[NSURLProtocol registerClass:[TVCImageURLoaderTestsStandInServer class]];
+
+	[TVCImageURLoaderTestsStandInServer resetStatistics];
+
+	[TVCImageURLoader invalidateInternalCache];
+
+	self.results = [NSMutableDictionary dictionary];
+
+	self.loaders = [NSMutableArray array];
+}
+
+- (void)tearDown
+{
+	[NSURLProtocol unregisterClass:[TVCImageURLoaderTestsStandInServer class]];
+
+	[super tearDown];
+}
+
+#pragma mark -
+#pragma mark Helpers
+
+- (NSString *)uniqueURLWithPath:(NSString *)path
+{
+	/* Every test uses URLs of its own so that nothing cached by an
+	 earlier run of the tests is found on disk. */
+	return [NSString stringWithFormat:@"http://%@/%@/%@.png", _standInHost, path, [NSString stringWithUUID]];
+}
+
+- (NSString *)diskCachePathForURL:(NSString *)url
+{
+	NSString *cachePath = [[TPCPathInfo applicationCachesFolderPath] stringByAppendingPathComponent:@"/Inline Image Probes/"];
+
+	return [cachePath stringByAppendingPathComponent:[[url md5] stringByAppendingPathExtension:@"plist"]];
+}
+
+- (void)writeProbeResultForURL:(NSString *)url probeDate:(NSDate *)probeDate
+{
+	NSString *filePath = [self diskCachePathForURL:url];
+
+	[RZFileManager() createDirectoryAtPath:[filePath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:NULL];
+
+	NSDictionary *probeResult = @{
+		@"responseIsValid"	: @(YES),
+		@"contentLength"	: @(68),
+		@"imageWidth"		: @(1),
+		@"imageHeight"		: @(1),
+		@"probeDate"		: probeDate,
+	};
+
+	XCTAssertTrue([probeResult writeToFile:filePath atomically:YES]);
+}
+
+- (void)assesURLs:(NSArray *)urls
+{
+	self.expectedResultCount = [urls count];
+
+	self.resultsExpectation = [self expectationWithDescription:@"All loaders answered"];
+
+	for (NSString *url in urls) {
+		TVCImageURLoader *loader = [TVCImageURLoader new];
+
+		[loader setDelegate:self];
+
+		/* The loaders are kept so that the weak delegate reference is
+		 the only thing being tested for lifetime. */
+		[self.loaders addObject:loader];
+
+		[loader assesURL:url withID:[NSString stringWithFormat:@"%lu", (unsigned long)[self.loaders count]]];
+	}
+
+	[self waitForExpectationsWithTimeout:30 handler:nil];
+}
+
+- (void)waitForDiskCacheQueue
+{
+	XCTestExpectation *expectation = [self expectationWithDescription:@"Disk cache settled"];
+
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.5 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+		[expectation fulfill];
+	});
+
+	[self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)recordResult:(BOOL)isSafe forUniqueID:(NSString *)uniqueID
+{
+	XCTAssertNil(self.results[uniqueID], @"Loader %@ was answered more than once", uniqueID);
+
+	self.results[uniqueID] = @(isSafe);
+
+	if ([self.results count] == self.expectedResultCount) {
+		[self.resultsExpectation fulfill];
+	}
+}
+
+- (void)isSafeToPresentImageWithID:(NSString *)uniqueID
+{
+	[self recordResult:YES forUniqueID:uniqueID];
+}
+
+- (void)isNotSafeToPresentImageWithID:(NSString *)uniqueID
+{
+	[self recordResult:NO forUniqueID:uniqueID];
+}
+
+#pragma mark -
+#pragma mark Tests
+
+- (void)testRequestsForTheSameURLAreDeduplicated
+{
+	NSString *url = [self uniqueURLWithPath:@"image"];
+
+	[self assesURLs:@[url, url, url]];
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer numberOfRequests], 1);
+
+	XCTAssertEqualObjects(self.results, (@{@"1" : @(YES), @"2" : @(YES), @"3" : @(YES)}));
+}
+
+- (void)testConcurrentRequestsAreCappedAtFour
+{
+	NSMutableArray *urls = [NSMutableArray array];
+
+	for (NSInteger i = 0; i < 10; i++) {
+		[urls addObject:[self uniqueURLWithPath:@"image"]];
+	}
+
+	[self assesURLs:urls];
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer numberOfRequests], 10);
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer maximumNumberOfConcurrentRequests], 4);
+}
+
+- (void)testDiskCacheIsUsedUntilItExpires
+{
+	NSString *freshURL = [self uniqueURLWithPath:@"image"];
+	NSString *expiredURL = [self uniqueURLWithPath:@"image"];
+
+	[self writeProbeResultForURL:freshURL probeDate:[NSDate date]];
+
+	[self writeProbeResultForURL:expiredURL probeDate:[NSDate dateWithTimeIntervalSinceNow:(-2 * 86400)]];
+
+	[self assesURLs:@[freshURL, expiredURL]];
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer numberOfRequests], 1);
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer numberOfRequestsForPath:[[NSURL URLWithString:expiredURL] path]], 1);
+
+	XCTAssertEqualObjects(self.results, (@{@"1" : @(YES), @"2" : @(YES)}));
+
+	/* The expired entry is replaced by the result of the new probe. */
+	[self waitForDiskCacheQueue];
+
+	NSDictionary *probeResult = [NSDictionary dictionaryWithContentsOfFile:[self diskCachePathForURL:expiredURL]];
+
+	XCTAssertTrue([probeResult[@"probeDate"] timeIntervalSinceNow] > -60);
+}
+
+- (void)testResponsesOtherThanOKAreNotCached
+{
+	NSString *url = [self uniqueURLWithPath:@"missing"];
+
+	[self assesURLs:@[url]];
+
+	[self waitForDiskCacheQueue];
+
+	XCTAssertFalse([RZFileManager() fileExistsAtPath:[self diskCachePathForURL:url]]);
+
+	/* Posting the link again probes it again. */
+	[self.results removeAllObjects];
+
+	[self assesURLs:@[url]];
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer numberOfRequests], 2);
+
+	XCTAssertEqualObjects(self.results, (@{@"2" : @(NO)}));
+}
+
+- (void)testDelegateIsNotMessagedAfterItIsReleased
+{
+	NSString *url = [self uniqueURLWithPath:@"image"];
+
+	TVCImageURLoader *loader = [TVCImageURLoader new];
+
+	@autoreleasepool {
+		TVCImageURLoaderTests *delegate = [TVCImageURLoaderTests new];
+
+		[loader setDelegate:delegate];
+
+		[loader assesURL:url withID:@"1"];
+	}
+
+	XCTAssertNil([loader delegate]);
+
+	/* Join the probe and let it finish. Messaging the released
+	 delegate of the first loader would crash here. */
+	[self assesURLs:@[url]];
+
+	XCTAssertEqual([TVCImageURLoaderTestsStandInServer numberOfRequests], 1);
+}
+
+@end
+
+#pragma mark -
+
+static NSInteger _standInNumberOfRequests = 0;
+static NSInteger _standInNumberOfConcurrentRequests = 0;
+static NSInteger _standInMaximumNumberOfConcurrentRequests = 0;
+
+static NSCountedSet *_standInRequestedPaths = nil;
+
+@interface TVCImageURLoaderTestsStandInServer ()
+@property (nonatomic, assign) BOOL requestIsOpen;
+@end
+
+@implementation TVCImageURLoaderTestsStandInServer
+
++ (void)resetStatistics
+{
+	@synchronized(self) {
+		_standInNumberOfRequests = 0;
+		_standInNumberOfConcurrentRequests = 0;
+		_standInMaximumNumberOfConcurrentRequests = 0;
+
+		_standInRequestedPaths = [NSCountedSet set];
+	}
+}
+
++ (NSInteger)numberOfRequests
+{
+	@synchronized(self) {
+		return _standInNumberOfRequests;
+	}
+}
+
++ (NSInteger)numberOfRequestsForPath:(NSString *)path
+{
+	@synchronized(self) {
+		return [_standInRequestedPaths countForObject:path];
+	}
+}
+
++ (NSInteger)maximumNumberOfConcurrentRequests
+{
+	@synchronized(self) {
+		return _standInMaximumNumberOfConcurrentRequests;
+	}
+}
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request
+{
+	return [[[request URL] host] isEqualToString:_standInHost];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request
+{
+	return request;
+}
+
+- (void)startLoading
+{
+	@synchronized([self class]) {
+		_standInNumberOfRequests += 1;
+		_standInNumberOfConcurrentRequests += 1;
+
+		if (_standInMaximumNumberOfConcurrentRequests < _standInNumberOfConcurrentRequests) {
+			_standInMaximumNumberOfConcurrentRequests = _standInNumberOfConcurrentRequests;
+		}
+
+		[_standInRequestedPaths addObject:[[[self request] URL] path]];
+	}
+
+	self.requestIsOpen = YES;
+
+	/* Answers have to be delivered on the thread that loading started on. */
+	[self performSelector:@selector(respond) withObject:nil afterDelay:_standInResponseDelay];
+}
+
+- (void)stopLoading
+{
+	[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(respond) object:nil];
+
+	[self closeRequest];
+}
+
+- (void)closeRequest
+{
+	if (self.requestIsOpen == NO) {
+		return;
+	}
+
+	self.requestIsOpen = NO;
+
+	@synchronized([self class]) {
+		_standInNumberOfConcurrentRequests -= 1;
+	}
+}
+
+- (void)respond
+{
+	NSURL *requestURL = [[self request] URL];
+
+	NSData *responseData = nil;
+
+	NSInteger statusCode = 200;
+
+	NSString *contentType = @"image/png";
+
+	if ([[requestURL path] hasPrefix:@"/missing/"]) {
+		responseData = [@"Not Found" dataUsingEncoding:NSUTF8StringEncoding];
+
+		statusCode = 404;
+
+		contentType = @"text/plain";
+	} else {
+		responseData = [[NSData alloc] initWithBase64EncodedString:@"iVBORw0KGgoAAAANSUhEUgAAAAEAAAABCAYAAAAfFcSJAAAADUlEQVR42mNkYPhfDwAChwGA60e6kgAAAABJRU5ErkJggg==" options:0];
+	}
+
+	NSDictionary *headerFields = @{
+		@"Content-Type"		: contentType,
+		@"Content-Length"	: [NSString stringWithFormat:@"%lu", (unsigned long)[responseData length]],
+	};
+
+	NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:requestURL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:headerFields];
+
+	/* The request is closed before the client is told that it finished
+	 so that the loader is free to start the next one right away. */
+	[self closeRequest];
+
+	[[self client] URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+	[[self client] URLProtocol:self didLoadData:responseData];
+	[[self client] URLProtocolDidFinishLoading:self];
+}
+
+@end
@@ -0,0 +1,161 @@
+/* ********************************************************************* 
+                  _____         _               _
+                 |_   _|____  _| |_ _   _  __ _| |
+                   | |/ _ \ \/ / __| | | |/ _` | |
+                   | |  __/>  <| |_| |_| | (_| | |
+                   |_|\___/_/\_\\__|\__,_|\__,_|_|
+
+ Copyright (c) 2008 - 2010 Satoshi Nakagawa <psychs AT limechat DOT net>
+ Copyright (c) 2010 - 2015 Codeux Software, LLC & respective contributors.
+        Please see Acknowledgements.pdf for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Textual and/or "Codeux Software, LLC", nor the 
+      names of its contributors may be used to endorse or promote products 
+      derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "TextualApplication.h"
+
+#import <XCTest/XCTest.h>
+
+/* +[TVCLogRenderer escapeString:] escapes in a single pass what used to be
+ escaped by gtm_stringByEscapingForHTML followed by the replacement of tabs
+ and double spaces. These tests hold it to the output of that chain. */
+@interface TVCLogRendererEscapingTests : XCTestCase
+@end
+
+@implementation TVCLogRendererEscapingTests
+
++ (NSString *)escapeStringUsingReplacements:(NSString *)s
+{
+	s = [s gtm_stringByEscapingForHTML];
+
+	s = [s stringByReplacingOccurrencesOfString:@"\t" withString:@"&nbsp;&nbsp;&nbsp;&nbsp;"];
+	s = [s stringByReplacingOccurrencesOfString:@"  " withString:@"&nbsp;&nbsp;"];
+
+	return s;
+}
+
++ (NSString *)longPlainLine
+{
+	return [NSStringEmptyPlaceholder stringByPaddingToLength:4000 withString:@"The quick brown fox jumps over the lazy dog. " startingAtIndex:0];
+}
+
++ (NSString *)longMarkupLine
+{
+	return [NSStringEmptyPlaceholder stringByPaddingToLength:4000 withString:@"<a href=\"x\">Tom & Jerry's</a>\t  " startingAtIndex:0];
+}
+
++ (NSString *)longNonASCIILine
+{
+	return [NSStringEmptyPlaceholder stringByPaddingToLength:4000 withString:@"Ünïcödé tëxt — “quoted” € 日本語 😀 " startingAtIndex:0];
+}
+
+- (void)testEscapingMatchesReplacements
+{
+	NSArray *inputs = @[
+		@"",
+		@"hey, is anyone around?",
+		@"I pushed the fix to the branch earlier today, could someone take a look at it when they get the chance",
+		@"I pushed the fix to the branch earlier today, could someone take a look at it when they get the chance?  ",
+		@"<script>alert(\"Tom & Jerry's\");</script>",
+		@"col1\tcol2\tcol3    aligned   text \t ",
+		@"Ünïcödé tëxt — 日本語のテキスト with an emoji 😀 & friends",
+		@"Œuvre ‘single’ “double” … † ‡ ‰ ‹ › € ˆ ˜ ƒ   ‌ ‍ ‎ ‏",
+		@"αβγ ΑΒΓ ϑϒϖ ∀∂∃∅∇∈ ♠♣♥♦ ⌈⌉⌊⌋ 〈〉",
+		[TVCLogRendererEscapingTests longPlainLine],
+		[TVCLogRendererEscapingTests longMarkupLine],
+		[TVCLogRendererEscapingTests longNonASCIILine],
+	];
+
+	for (NSString *input in inputs) {
+		NSString *expectedResult = [TVCLogRendererEscapingTests escapeStringUsingReplacements:input];
+
+		NSString *actualResult = [TVCLogRenderer escapeString:input];
+
+		XCTAssertEqualObjects(actualResult, expectedResult, @"Unexpected result for %@", input);
+	}
+}
+
+- (void)testEscapingUsesNamedEntities
+{
+	XCTAssertEqualObjects([TVCLogRenderer escapeString:@"Tom — Jerry"], @"Tom &mdash; Jerry");
+
+	XCTAssertEqualObjects([TVCLogRenderer escapeString:@"“€”"], @"&ldquo;&euro;&rdquo;");
+}
+
+- (void)testPerformanceOfReplacements
+{
+	NSString *input = [TVCLogRendererEscapingTests longMarkupLine];
+
+	[self measureBlock:^{
+		for (NSInteger i = 0; i < 100; i++) {
+			@autoreleasepool {
+				(void)[TVCLogRendererEscapingTests escapeStringUsingReplacements:input];
+			}
+		}
+	}];
+}
+
+- (void)testPerformanceOfSinglePass
+{
+	NSString *input = [TVCLogRendererEscapingTests longMarkupLine];
+
+	[self measureBlock:^{
+		for (NSInteger i = 0; i < 100; i++) {
+			@autoreleasepool {
+				(void)[TVCLogRenderer escapeString:input];
+			}
+		}
+	}];
+}
+
+- (void)testPerformanceOfSinglePassWithPlainText
+{
+	NSString *input = [TVCLogRendererEscapingTests longPlainLine];
+
+	[self measureBlock:^{
+		for (NSInteger i = 0; i < 100; i++) {
+			@autoreleasepool {
+				(void)[TVCLogRenderer escapeString:input];
+			}
+		}
+	}];
+}
+
+- (void)testPerformanceOfSinglePassWithNonASCIIText
+{
+	NSString *input = [TVCLogRendererEscapingTests longNonASCIILine];
+
+	[self measureBlock:^{
+		for (NSInteger i = 0; i < 100; i++) {
+			@autoreleasepool {
+				(void)[TVCLogRenderer escapeString:input];
+			}
+		}
+	}];
+}
+
+@end